@@ -164,6 +164,7 @@ MainWindow::MainWindow(QWidget *parent)
     
     // Connect History button
     connect(ui->historyButton, &QPushButton::clicked, this, &MainWindow::requestHistory);
+    connect(ui->leaderboardButton, &QPushButton::clicked, this, &MainWindow::requestLeaderboard);
     
     // Connect color selection buttons
     connect(ui->colorButtonBlack, &QPushButton::clicked, this, &MainWindow::onColorButtonClicked);
@@ -193,14 +194,67 @@ void MainWindow::requestHistory()
 {
     if (!connected) return;
     
+    historyRecords.clear();
+    requestHistoryPage(0);
+    addChatMessage("Requesting history...");
+}
+
+void MainWindow::requestHistoryPage(int beforeRecordId)
+{
+    if (!connected) return;
+
     HistoryRequestMessage msg;
+    memset(&msg, 0, sizeof(msg));
     msg.base.type = MSG_HISTORY_REQ;
     msg.base.client_id = clientId;
-    msg.base.data_len = 0;
-    
+    msg.base.data_len = sizeof(HistoryRequestMessage) - sizeof(BaseMessage);
+    msg.before_record_id = beforeRecordId;
+    msg.page_size = HISTORY_PAGE_ROWS;
     sendTcpMessage(msg.base);
-    historyRecords.clear();
-    addChatMessage("Requesting history...");
+}
+
+void MainWindow::appendHistoryRows(int from)
+{
+    historyTable->setRowCount(historyRecords.size());
+    for (int i = from; i < historyRecords.size(); ++i) {
+        const auto& record = historyRecords[i];
+        historyTable->setItem(i, 0, new QTableWidgetItem(QString::number(record.game_id)));
+        historyTable->setItem(i, 1, new QTableWidgetItem(record.word));
+        historyTable->setItem(i, 2, new QTableWidgetItem(record.user_guess));
+        historyTable->setItem(i, 3, new QTableWidgetItem(record.game_time));
+    }
+}
+
+void MainWindow::requestLeaderboard()
+{
+    if (!connected) return;
+
+    LeaderboardRequestMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.base.type = MSG_LEADERBOARD_REQ;
+    msg.base.client_id = clientId;
+    msg.base.data_len = sizeof(LeaderboardRequestMessage) - sizeof(BaseMessage);
+    msg.count = LEADERBOARD_MAX_ROWS;
+    strncpy(msg.username, nickname.toUtf8().constData(), sizeof(msg.username) - 1);
+    sendTcpMessage(msg.base);
+}
+
+void MainWindow::requestReplay(int gameId, int speed)
+{
+    if (!connected) return;
+
+    ReplayRequestMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.base.type = MSG_REPLAY_REQ;
+    msg.base.client_id = clientId;
+    msg.base.data_len = sizeof(ReplayRequestMessage) - sizeof(BaseMessage);
+    msg.game_id = gameId;
+    msg.speed = speed;
+    sendTcpMessage(msg.base);
+
+    replayGameId = gameId;
+    drawingWidget->clearCanvas();
+    addChatMessage(QString("Replaying game %1...").arg(gameId));
 }
 
 void MainWindow::showHistoryDialog()
@@ -216,18 +270,43 @@ void MainWindow::showHistoryDialog()
     table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     table->setEditTriggers(QAbstractItemView::NoEditTriggers); // Make read-only
     table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    historyTable = table;
+    appendHistoryRows(0);
     
-    table->setRowCount(historyRecords.size());
-    for (int i = 0; i < historyRecords.size(); ++i) {
-        const auto& record = historyRecords[i];
-        table->setItem(i, 0, new QTableWidgetItem(QString::number(record.game_id)));
-        table->setItem(i, 1, new QTableWidgetItem(record.word));
-        table->setItem(i, 2, new QTableWidgetItem(record.user_guess));
-        table->setItem(i, 3, new QTableWidgetItem(record.game_time));
-    }
+    // Older pages are fetched on demand and appended as they arrive
+    QPushButton *moreButton = new QPushButton("Load More", &dialog);
+    moreButton->setEnabled(historyMore);
+    historyMoreButton = moreButton;
+    connect(moreButton, &QPushButton::clicked, this, [this, moreButton]() {
+        moreButton->setEnabled(false);
+        requestHistoryPage(historyCursor);
+    });
+    
+    // Replay the selected round on the canvas, at recorded pace or faster
+    QHBoxLayout *replayLayout = new QHBoxLayout();
+    QComboBox *speedCombo = new QComboBox(&dialog);
+    speedCombo->addItem("Instant", 0);
+    speedCombo->addItem("1x", 1);
+    speedCombo->addItem("2x", 2);
+    speedCombo->addItem("4x", 4);
+    speedCombo->setCurrentIndex(1);
+    QPushButton *replayButton = new QPushButton("Replay", &dialog);
+    replayButton->setEnabled(gameState != GAME_PAINTING && gameState != GAME_GUESSING);
+    connect(replayButton, &QPushButton::clicked, this, [this, table, speedCombo, &dialog]() {
+        int row = table->currentRow();
+        if (row < 0 || row >= historyRecords.size()) return;
+        requestReplay(historyRecords[row].game_id, speedCombo->currentData().toInt());
+        dialog.accept();
+    });
+    replayLayout->addWidget(speedCombo);
+    replayLayout->addWidget(replayButton);
     
     layout->addWidget(table);
+    layout->addWidget(moreButton);
+    layout->addLayout(replayLayout);
     dialog.exec();
+    historyTable = nullptr;
+    historyMoreButton = nullptr;
 }
 
 MainWindow::~MainWindow()
@@ -253,6 +332,7 @@ void MainWindow::connectToServer()
         ui->statusLabel->setText("Connected");
         ui->roomListButton->setEnabled(true);
         ui->historyButton->setEnabled(true);
+        ui->leaderboardButton->setEnabled(true);
         addChatMessage("Connected to server");
         updateIdentityDisplay();
         
@@ -272,6 +352,7 @@ void MainWindow::connectToServer()
         ui->roomListButton->setEnabled(false);
         ui->readyButton->setEnabled(false);
         ui->historyButton->setEnabled(false);
+        ui->leaderboardButton->setEnabled(false);
         ui->leaveRoomButton->setEnabled(false);
         addChatMessage("Disconnected from server");
     });
@@ -338,14 +419,14 @@ void MainWindow::submitGuess()
 void MainWindow::onTcpDataReceived()
 {
     while (tcpSocket->bytesAvailable() >= static_cast<qint64>(sizeof(BaseMessage))) {
-        QByteArray data = tcpSocket->read(sizeof(BaseMessage));
-        BaseMessage* msg = (BaseMessage*)data.data();
-        
-        if (tcpSocket->bytesAvailable() >= msg->data_len) {
-            QByteArray fullData = tcpSocket->read(msg->data_len);
-            data.append(fullData);
-            handleTcpMessage(*(BaseMessage*)data.data());
+        // Peek first: large frames (history pages) can arrive in pieces
+        BaseMessage header;
+        tcpSocket->peek((char*)&header, sizeof(BaseMessage));
+        if (tcpSocket->bytesAvailable() < static_cast<qint64>(sizeof(BaseMessage) + header.data_len)) {
+            break;
         }
+        QByteArray data = tcpSocket->read(sizeof(BaseMessage) + header.data_len);
+        handleTcpMessage(*(BaseMessage*)data.data());
     }
 }
 
@@ -508,6 +589,7 @@ void MainWindow::handleTcpMessage(const BaseMessage& msg)
     ui->readyButton->setEnabled(true);
     ui->readyButton->setText("Ready");
     ui->historyButton->setEnabled(true);
+    ui->leaderboardButton->setEnabled(true);
     ui->guessEdit->setEnabled(false);
             ui->guessEdit->clear();
             ui->submitButton->setEnabled(false);
@@ -541,6 +623,104 @@ void MainWindow::handleTcpMessage(const BaseMessage& msg)
             showHistoryDialog();
             break;
         }
+        
+        case MSG_HISTORY_PAGE: {
+            HistoryPageMessage* pageMsg = (HistoryPageMessage*)&msg;
+            int from = historyRecords.size();
+            for (int i = 0; i < pageMsg->count && i < HISTORY_PAGE_ROWS; ++i) {
+                const HistoryRow& row = pageMsg->rows[i];
+                HistoryRecord record;
+                record.game_id = row.game_id;
+                record.word = QString::fromUtf8(row.word);
+                record.user_guess = QString::fromUtf8(row.user_guess);
+                record.game_time = QString::fromUtf8(row.game_time);
+                historyRecords.append(record);
+            }
+            historyCursor = pageMsg->next_before;
+            historyMore = pageMsg->more;
+            if (historyTable) {
+                appendHistoryRows(from);
+                historyMoreButton->setEnabled(historyMore);
+            } else {
+                showHistoryDialog();
+            }
+            break;
+        }
+
+        case MSG_REPLAY_DATA: {
+            ReplayDataMessage* replayMsg = (ReplayDataMessage*)&msg;
+            // A round in progress owns the canvas; frames of a replaced replay are stale
+            if (replayMsg->game_id != replayGameId || gameState == GAME_PAINTING || gameState == GAME_GUESSING) {
+                break;
+            }
+            int count = qMin((int)replayMsg->count, REPLAY_BATCH_POINTS);
+            for (int i = 0; i < count; ++i) {
+                const ReplayPoint& pt = replayMsg->points[i];
+                if (pt.action == 3) {
+                    drawingWidget->clearCanvas();
+                    continue;
+                }
+                PaintDataMessage paint;
+                memset(&paint, 0, sizeof(paint));
+                paint.x = pt.x;
+                paint.y = pt.y;
+                paint.action = pt.action;
+                paint.color_r = pt.color_r;
+                paint.color_g = pt.color_g;
+                paint.color_b = pt.color_b;
+                drawingWidget->addPaintData(paint);
+            }
+            break;
+        }
+
+        case MSG_REPLAY_END: {
+            ReplayEndMessage* endMsg = (ReplayEndMessage*)&msg;
+            if (endMsg->game_id != replayGameId) break;
+            replayGameId = 0;
+            switch (endMsg->status) {
+                case REPLAY_DONE: addChatMessage(QString("Replay of game %1 finished").arg(endMsg->game_id)); break;
+                case REPLAY_NOT_FOUND: addChatMessage(QString("No drawing stored for game %1").arg(endMsg->game_id)); break;
+                case REPLAY_BUSY: addChatMessage("Replay server is busy, try again later"); break;
+                default: addChatMessage(QString("Replay of game %1 failed").arg(endMsg->game_id)); break;
+            }
+            break;
+        }
+
+        case MSG_LEADERBOARD: {
+            LeaderboardMessage* lbMsg = (LeaderboardMessage*)&msg;
+            QDialog dialog(this);
+            dialog.setWindowTitle("Leaderboard");
+            dialog.resize(600, 450);
+
+            QVBoxLayout *layout = new QVBoxLayout(&dialog);
+            const LeaderboardEntry& me = lbMsg->player;
+            QString summary = me.rank > 0
+                ? QString("Your rank: %1 of %2 (%3 wins in %4 games)").arg(me.rank).arg(lbMsg->total_players).arg(me.wins).arg(me.games)
+                : QString("No games recorded for you yet (%1 players ranked)").arg(lbMsg->total_players);
+            layout->addWidget(new QLabel(summary, &dialog));
+
+            QTableWidget *table = new QTableWidget(&dialog);
+            table->setColumnCount(6);
+            table->setHorizontalHeaderLabels({"Rank", "Player", "Wins", "Games", "Accuracy", "AI Beaten"});
+            table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+            table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+            table->setSelectionBehavior(QAbstractItemView::SelectRows);
+            int count = qMin((int)lbMsg->count, LEADERBOARD_MAX_ROWS);
+            table->setRowCount(count);
+            for (int i = 0; i < count; ++i) {
+                const LeaderboardEntry& e = lbMsg->entries[i];
+                QString accuracy = e.guesses > 0 ? QString("%1%").arg(100 * e.wins / e.guesses) : "-";
+                table->setItem(i, 0, new QTableWidgetItem(QString::number(e.rank)));
+                table->setItem(i, 1, new QTableWidgetItem(QString::fromUtf8(e.username, strnlen(e.username, sizeof(e.username)))));
+                table->setItem(i, 2, new QTableWidgetItem(QString::number(e.wins)));
+                table->setItem(i, 3, new QTableWidgetItem(QString::number(e.games)));
+                table->setItem(i, 4, new QTableWidgetItem(accuracy));
+                table->setItem(i, 5, new QTableWidgetItem(QString::number(e.ai_beaten)));
+            }
+            layout->addWidget(table);
+            dialog.exec();
+            break;
+        }
 
         case MSG_ROOM_LIST: {
             RoomListMessage* roomListMsg = (RoomListMessage*)&msg;
@@ -589,6 +769,10 @@ void MainWindow::handleTcpMessage(const BaseMessage& msg)
                 QVBoxLayout* createLayout = new QVBoxLayout(&createDialog);
                 QLineEdit* roomNameEdit = new QLineEdit(&createDialog);
                 QLineEdit* nicknameEdit = new QLineEdit(&createDialog);
+                QLineEdit* categoryEdit = new QLineEdit(&createDialog);
+                categoryEdit->setPlaceholderText("any");
+                QComboBox* difficultyBox = new QComboBox(&createDialog);
+                difficultyBox->addItems({"Any", "Easy", "Medium", "Hard"});
                 QPushButton* createConfirmButton = new QPushButton("Create", &createDialog);
                 QPushButton* createCancelButton = new QPushButton("Cancel", &createDialog);
 
@@ -596,10 +780,14 @@ void MainWindow::handleTcpMessage(const BaseMessage& msg)
                 createLayout->addWidget(roomNameEdit);
                 createLayout->addWidget(new QLabel("Your Nickname:"));
                 createLayout->addWidget(nicknameEdit);
+                createLayout->addWidget(new QLabel("Word Category:"));
+                createLayout->addWidget(categoryEdit);
+                createLayout->addWidget(new QLabel("Difficulty:"));
+                createLayout->addWidget(difficultyBox);
                 createLayout->addWidget(createConfirmButton);
                 createLayout->addWidget(createCancelButton);
 
-                QObject::connect(createConfirmButton, &QPushButton::clicked, this, [this, &createDialog, &dialog, roomNameEdit, nicknameEdit]() {
+                QObject::connect(createConfirmButton, &QPushButton::clicked, this, [this, &createDialog, &dialog, roomNameEdit, nicknameEdit, categoryEdit, difficultyBox]() {
                     QString roomName = roomNameEdit->text().trimmed();
                     QString nickname = nicknameEdit->text().trimmed();
                     if (roomName.isEmpty() || nickname.isEmpty()) {
@@ -607,11 +795,14 @@ void MainWindow::handleTcpMessage(const BaseMessage& msg)
                         return;
                     }
                     CreateRoomMessage createMsg;
+                    memset(&createMsg, 0, sizeof(createMsg));
                     createMsg.base.type = MSG_CREATE_ROOM;
                     createMsg.base.client_id = clientId;
                     createMsg.base.data_len = sizeof(CreateRoomMessage) - sizeof(BaseMessage);
                     strcpy(createMsg.room_name, roomName.toUtf8().constData());
                     strcpy(createMsg.nickname, nickname.toUtf8().constData());
+                    strncpy(createMsg.category, categoryEdit->text().trimmed().toUtf8().constData(), sizeof(createMsg.category) - 1);
+                    createMsg.difficulty = (uint8_t)difficultyBox->currentIndex();
                     sendTcpMessage(createMsg.base);
                     this->nickname = nickname;
                     createDialog.accept();
@@ -729,6 +920,20 @@ void MainWindow::handleTcpMessage(const BaseMessage& msg)
             addChatMessage(text);
             break;
         }
+
+        case MSG_AI_LIVE_GUESS: {
+            AiLiveGuessMessage* liveMsg = (AiLiveGuessMessage*)&msg;
+            if (isPainter || liveMsg->num_guesses == 0) break;
+
+            QStringList guesses;
+            for (int i = 0; i < liveMsg->num_guesses && i < 3; i++) {
+                QString word = QString::fromUtf8(liveMsg->words[i], strnlen(liveMsg->words[i], 32));
+                guesses << QString("%1 %2%").arg(word).arg(liveMsg->scores[i]);
+            }
+            ui->aiLabel->setStyleSheet("QLabel { background-color: #f3e5f5; color: #7b1fa2; border: 2px solid #9c27b0; border-radius: 10px; font-size: 14px; font-weight: bold; padding: 8px; }");
+            ui->aiLabel->setText("AI thinks: " + guesses.join(", "));
+            break;
+        }
     }
 }
 
@@ -7,7 +7,7 @@ echo ===================================
 echo [1/3] Compiling Server...
 cd server
 if exist draw_guess_server.exe del draw_guess_server.exe
-D:\env\Cygwin\bin\gcc.exe -o draw_guess_server.exe draw_guess_server.c protocol.c sqlite3.c -lpthread
+D:\env\Cygwin\bin\gcc.exe -o draw_guess_server.exe draw_guess_server.c protocol.c raster.c raster_kernels.c embed_index.c ai_client.c ai_batch.c ai_backend.c ai_onnx.c ai_cache.c ai_sidecar.c ai_shm.c ai_player.c metrics.c stroke_buffer.c db.c word_bank.c drawing_store.c leaderboard.c replay.c retention.c sqlite3.c -lpthread -lm
 if %errorlevel% == 0 (
     echo    - Server compiled successfully.
 ) else (
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ai_client.h"
+#include "ai_backend.h"
+#include "ai_sidecar.h"
+#include "ai_shm.h"
+#include "metrics.h"
+
+static int python_start(void) {
+    printf("Starting AI service...\n");
+    #ifdef _WIN32
+    system("start /B python ai_service.py");
+    #else
+    ai_sidecar_start(NULL, NULL);
+    #endif
+    return 0;
+}
+
+static int python_ready(void) {
+    #ifdef _WIN32
+    return 1; // not supervised, requests fail until the service is up
+    #else
+    return ai_sidecar_ready();
+    #endif
+}
+
+const AiBackend ai_backend_python = {
+    "python",
+    python_start,
+    python_ready,
+    ai_encode_words,
+    ai_encode_images
+};
+
+#ifdef __linux__
+static int python_shm_start(void) {
+    if (ai_shm_init() != 0) return -1;
+    printf("Starting AI service...\n");
+    ai_sidecar_start(ai_shm_env(), ai_shm_reset);
+    return 0;
+}
+
+const AiBackend ai_backend_python_shm = {
+    "python-shm",
+    python_shm_start,
+    python_ready,
+    ai_encode_words,
+    ai_shm_encode_images
+};
+#endif
+
+static const AiBackend* const backends[] = {
+    &ai_backend_python,
+#ifdef __linux__
+    &ai_backend_python_shm,
+#endif
+#ifdef WITH_ONNXRUNTIME
+    &ai_backend_onnx,
+#endif
+};
+
+static const AiBackend* current = &ai_backend_python;
+
+int ai_backend_select(const char* name) {
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (strcmp(backends[i]->name, name) == 0) {
+            current = backends[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const AiBackend* ai_backend(void) {
+    return current;
+}
+
+int ai_backend_start(void) {
+    printf("AI backend: %s\n", current->name);
+    return current->start();
+}
+
+int ai_backend_ready(void) {
+    if (current->ready()) return 1;
+    metric_inc(METRIC_AI_NOT_READY);
+    return 0;
+}
+
+static pthread_mutex_t breaker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int breaker_failures = 0;
+static long long breaker_open_until = 0;
+
+int ai_breaker_allow(void) {
+    int allow = 1;
+    pthread_mutex_lock(&breaker_mutex);
+    if (breaker_failures >= AI_BREAKER_FAILURES) {
+        long long now = ai_clock_ms();
+        if (now < breaker_open_until) {
+            allow = 0;
+        } else {
+            // Let this one through as the trial; the rest wait another
+            // cool-down unless it succeeds
+            breaker_open_until = now + AI_BREAKER_COOLDOWN_MS;
+        }
+    }
+    pthread_mutex_unlock(&breaker_mutex);
+    if (!allow) metric_inc(METRIC_AI_BREAKER_SKIPS);
+    return allow;
+}
+
+void ai_breaker_report(int ok) {
+    pthread_mutex_lock(&breaker_mutex);
+    if (ok) {
+        if (breaker_failures >= AI_BREAKER_FAILURES) printf("AI: Backend recovered, circuit closed\n");
+        breaker_failures = 0;
+    } else if (++breaker_failures >= AI_BREAKER_FAILURES) {
+        breaker_open_until = ai_clock_ms() + AI_BREAKER_COOLDOWN_MS;
+        metric_inc(METRIC_AI_BREAKER_OPENS);
+        printf("AI: %d failures in a row, skipping AI for %d ms\n", breaker_failures, AI_BREAKER_COOLDOWN_MS);
+    }
+    pthread_mutex_unlock(&breaker_mutex);
+}
@@ -0,0 +1,56 @@
+#ifndef AI_BACKEND_H
+#define AI_BACKEND_H
+
+#include <stdint.h>
+#include "raster.h"
+#include "embed_index.h"
+
+// Inference backends. The server only needs word embeddings once per
+// candidate set and image embeddings per round; where they are computed is
+// up to the backend:
+//   "python" - ai_service.py over the local socket (ai_client.h), run
+//              under ai_sidecar.h; default
+//   "python-shm" - the same service, with image batches passed through
+//              shared memory rings (ai_shm.h, Linux only)
+//   "onnx"   - exported CLIP image encoder run in-process with ONNX Runtime
+//              (only when built with -DWITH_ONNXRUNTIME, see ai_onnx.c)
+
+typedef struct {
+    const char* name;
+    // Launch or load the backend without blocking on it; 0 on success
+    int (*start)(void);
+    // Whether requests can be served right now
+    int (*ready)(void);
+    // Same contracts as ai_encode_words() / ai_encode_images()
+    EmbedIndex* (*encode_words)(uint32_t set_id, const char* block, uint32_t len, uint32_t count);
+    int (*encode_images)(const Raster* const* rasters, int count, long long deadline_ms,
+                         float** out_embeddings, int* out_dim);
+} AiBackend;
+
+extern const AiBackend ai_backend_python;
+#ifdef __linux__
+extern const AiBackend ai_backend_python_shm;
+#endif
+#ifdef WITH_ONNXRUNTIME
+extern const AiBackend ai_backend_onnx;
+#endif
+
+// Pick a backend by name before ai_backend_start(); -1 if unknown or not
+// compiled in
+int ai_backend_select(const char* name);
+const AiBackend* ai_backend(void);
+int ai_backend_start(void);
+// Backend ready; counts a skipped request when not
+int ai_backend_ready(void);
+
+// Circuit breaker around the backend: after AI_BREAKER_FAILURES failed
+// calls in a row, requests are skipped for AI_BREAKER_COOLDOWN_MS, then a
+// single trial request decides whether to close it again. Callers ask
+// ai_breaker_allow() before a call and report its outcome.
+#define AI_BREAKER_FAILURES 3
+#define AI_BREAKER_COOLDOWN_MS 30000
+
+int ai_breaker_allow(void);
+void ai_breaker_report(int ok);
+
+#endif
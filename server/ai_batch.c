@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "ai_client.h"
+#include "ai_backend.h"
+#include "ai_batch.h"
+#include "metrics.h"
+
+enum {
+    REQ_QUEUED,
+    REQ_IN_FLIGHT,
+    REQ_DONE,
+    REQ_FAILED,
+    REQ_CANCELLED
+};
+
+typedef struct AiBatchRequest {
+    const Raster* raster;
+    int tag;
+    long long enqueued_ms;
+    long long deadline_ms;
+    float* embedding;
+    int dim;
+    int state;
+    struct AiBatchRequest* next;
+} AiBatchRequest;
+
+static pthread_mutex_t batch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batch_queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t batch_done = PTHREAD_COND_INITIALIZER;
+static AiBatchRequest* queue_head = NULL;
+static AiBatchRequest* queue_tail = NULL;
+static int queue_len = 0;
+static int batch_window_ms = 0;
+static int batch_max = 0;
+static int batch_running = 0;
+
+// Stats, under batch_mutex
+static long long total_batches = 0;
+static long long total_images = 0;
+
+// Condvars time out on the realtime clock; carry an ai_clock_ms() deadline
+// over as an offset from now
+static struct timespec to_timespec(long long ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    long long left = ms - ai_clock_ms();
+    if (left < 0) left = 0;
+    long long nsec = ts.tv_nsec + (left % 1000) * 1000000;
+    ts.tv_sec += left / 1000 + nsec / 1000000000;
+    ts.tv_nsec = nsec % 1000000000;
+    return ts;
+}
+
+// Unlink a queued request; called with batch_mutex held
+static void unqueue(AiBatchRequest* req) {
+    AiBatchRequest* prev = NULL;
+    for (AiBatchRequest* r = queue_head; r; prev = r, r = r->next) {
+        if (r != req) continue;
+        if (prev) prev->next = r->next; else queue_head = r->next;
+        if (queue_tail == r) queue_tail = prev;
+        queue_len--;
+        return;
+    }
+}
+
+static void* batch_scheduler(void* arg) {
+    (void)arg;
+    const Raster** rasters = malloc(sizeof(Raster*) * batch_max);
+    AiBatchRequest** batch = malloc(sizeof(AiBatchRequest*) * batch_max);
+    if (!rasters || !batch) {
+        printf("AI batch: out of memory, scheduler not running\n");
+        free(rasters);
+        free(batch);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&batch_mutex);
+    while (1) {
+        while (queue_len == 0) pthread_cond_wait(&batch_queued, &batch_mutex);
+
+        // Wait for the batch to fill or the oldest request's window to run
+        // out (leftovers from the last batch go straight away)
+        while (queue_head && queue_len < batch_max && ai_clock_ms() < queue_head->enqueued_ms + batch_window_ms) {
+            struct timespec ts = to_timespec(queue_head->enqueued_ms + batch_window_ms);
+            pthread_cond_timedwait(&batch_queued, &batch_mutex, &ts);
+        }
+        if (!queue_head) continue; // everything was cancelled meanwhile
+
+        // Already expired requests are failed here; the call gives up at the
+        // earliest deadline left, so no waiter is held past its own
+        int n = 0;
+        int expired = 0;
+        long long now = ai_clock_ms();
+        long long deadline = 0;
+        long long waited = now - queue_head->enqueued_ms;
+        while (queue_head && n < batch_max) {
+            AiBatchRequest* req = queue_head;
+            queue_head = req->next;
+            queue_len--;
+            if (req->deadline_ms <= now) {
+                req->state = REQ_FAILED;
+                metric_inc(METRIC_AI_TIMEOUTS);
+                expired++;
+                continue;
+            }
+            req->state = REQ_IN_FLIGHT;
+            if (n == 0 || req->deadline_ms < deadline) deadline = req->deadline_ms;
+            batch[n] = req;
+            rasters[n] = req->raster;
+            n++;
+        }
+        if (!queue_head) queue_tail = NULL;
+        if (expired > 0) pthread_cond_broadcast(&batch_done);
+        if (n == 0) continue;
+        pthread_mutex_unlock(&batch_mutex);
+
+        float* embeddings = NULL;
+        int dim = 0;
+        long long start = ai_clock_ms();
+        int ok = ai_backend()->encode_images(rasters, n, deadline, &embeddings, &dim) == 0;
+        long long took = ai_clock_ms() - start;
+        ai_breaker_report(ok);
+
+        // Split the result rows back out; waiters only look at them once
+        // state changes under the lock
+        for (int i = 0; i < n && ok; i++) {
+            batch[i]->embedding = malloc(sizeof(float) * dim);
+            if (batch[i]->embedding) {
+                memcpy(batch[i]->embedding, embeddings + (size_t)i * dim, sizeof(float) * dim);
+                batch[i]->dim = dim;
+            }
+        }
+        free(embeddings);
+
+        pthread_mutex_lock(&batch_mutex);
+        for (int i = 0; i < n; i++) {
+            batch[i]->state = batch[i]->embedding ? REQ_DONE : REQ_FAILED;
+        }
+        total_batches++;
+        total_images += n;
+        printf("AI batch: %d image(s) in %lld ms, first waited %lld ms (avg batch %.2f)\n",
+               n, took, waited, (double)total_images / total_batches);
+        pthread_cond_broadcast(&batch_done);
+    }
+    return NULL;
+}
+
+void ai_batch_start(int window_ms, int max_batch) {
+    pthread_mutex_lock(&batch_mutex);
+    if (batch_running) {
+        pthread_mutex_unlock(&batch_mutex);
+        return;
+    }
+    batch_window_ms = window_ms > 0 ? window_ms : 0;
+    batch_max = max_batch > 1 ? max_batch : 1;
+
+    pthread_t scheduler;
+    if (pthread_create(&scheduler, NULL, batch_scheduler, NULL) == 0) {
+        pthread_detach(scheduler);
+        batch_running = 1;
+        printf("AI batching: window %d ms, up to %d images\n", batch_window_ms, batch_max);
+    }
+    pthread_mutex_unlock(&batch_mutex);
+}
+
+int ai_batch_encode_image(const Raster* raster, int tag, long long deadline_ms,
+                          float** out_embedding, int* out_dim) {
+    if (!ai_backend_ready() || !ai_breaker_allow()) return -1;
+
+    pthread_mutex_lock(&batch_mutex);
+    if (!batch_running) {
+        pthread_mutex_unlock(&batch_mutex);
+        int rc = ai_backend()->encode_images(&raster, 1, deadline_ms, out_embedding, out_dim);
+        ai_breaker_report(rc == 0);
+        return rc;
+    }
+
+    AiBatchRequest req;
+    memset(&req, 0, sizeof(req));
+    req.raster = raster;
+    req.tag = tag;
+    req.enqueued_ms = ai_clock_ms();
+    req.deadline_ms = deadline_ms;
+    req.state = REQ_QUEUED;
+    if (queue_tail) queue_tail->next = &req; else queue_head = &req;
+    queue_tail = &req;
+    queue_len++;
+    pthread_cond_signal(&batch_queued);
+
+    while (req.state == REQ_QUEUED || req.state == REQ_IN_FLIGHT) {
+        // Only a request still in the queue can give up; once in flight the
+        // scheduler holds on to it until the call returns
+        if (req.state == REQ_QUEUED && ai_clock_ms() >= deadline_ms) {
+            unqueue(&req);
+            req.state = REQ_FAILED;
+            metric_inc(METRIC_AI_TIMEOUTS);
+            break;
+        }
+        if (req.state == REQ_QUEUED) {
+            struct timespec ts = to_timespec(deadline_ms);
+            pthread_cond_timedwait(&batch_done, &batch_mutex, &ts);
+        } else {
+            pthread_cond_wait(&batch_done, &batch_mutex);
+        }
+    }
+    pthread_mutex_unlock(&batch_mutex);
+
+    if (req.state != REQ_DONE) {
+        free(req.embedding);
+        return -1;
+    }
+    *out_embedding = req.embedding;
+    *out_dim = req.dim;
+    return 0;
+}
+
+void ai_batch_cancel(int tag) {
+    pthread_mutex_lock(&batch_mutex);
+    int cancelled = 0;
+    AiBatchRequest* r = queue_head;
+    while (r) {
+        AiBatchRequest* next = r->next;
+        if (r->tag == tag) {
+            unqueue(r);
+            r->state = REQ_CANCELLED;
+            cancelled++;
+        }
+        r = next;
+    }
+    if (cancelled > 0) {
+        metric_add(METRIC_AI_CANCELLED, cancelled);
+        pthread_cond_broadcast(&batch_done);
+    }
+    pthread_mutex_unlock(&batch_mutex);
+}
+
+typedef struct {
+    Raster* raster;
+    int tag;
+    int requests;
+    long long* latency_ms; // requests entries
+    int failed;
+} BenchClient;
+
+static void* bench_client(void* arg) {
+    BenchClient* c = (BenchClient*)arg;
+    for (int i = 0; i < c->requests; i++) {
+        float* embedding = NULL;
+        int dim = 0;
+        long long start = ai_clock_ms();
+        if (ai_batch_encode_image(c->raster, c->tag, start + AI_BENCH_DEADLINE_MS, &embedding, &dim) != 0) c->failed++;
+        c->latency_ms[i] = ai_clock_ms() - start;
+        free(embedding);
+    }
+    return NULL;
+}
+
+static int cmp_ll(const void* a, const void* b) {
+    long long x = *(const long long*)a, y = *(const long long*)b;
+    return x < y ? -1 : x > y;
+}
+
+// clients threads, each sending requests images back to back like rooms
+// asking for live guesses
+static void bench_round(const char* label, Raster* rasters, int clients, int requests) {
+    BenchClient* c = calloc(clients, sizeof(BenchClient));
+    pthread_t* threads = calloc(clients, sizeof(pthread_t));
+    long long* latency = calloc((size_t)clients * requests, sizeof(long long));
+    if (!c || !threads || !latency) {
+        free(c);
+        free(threads);
+        free(latency);
+        return;
+    }
+    long long start = ai_clock_ms();
+    for (int i = 0; i < clients; i++) {
+        c[i].raster = &rasters[i];
+        c[i].tag = i;
+        c[i].requests = requests;
+        c[i].latency_ms = latency + (size_t)i * requests;
+        pthread_create(&threads[i], NULL, bench_client, &c[i]);
+    }
+    int failed = 0;
+    for (int i = 0; i < clients; i++) {
+        pthread_join(threads[i], NULL);
+        failed += c[i].failed;
+    }
+    long long took = ai_clock_ms() - start;
+
+    int total = clients * requests;
+    qsort(latency, total, sizeof(long long), cmp_ll);
+    printf("  %-10s %6.1f images/s  p50 %4lld ms  p99 %4lld ms  (%d images in %lld ms, %d failed)\n",
+           label, total * 1000.0 / (took > 0 ? took : 1), latency[total / 2], latency[(total * 99) / 100],
+           total, took, failed);
+    free(c);
+    free(threads);
+    free(latency);
+}
+
+void ai_batch_benchmark(int window_ms, int max_batch) {
+    const int clients = AI_BENCH_CLIENTS, requests = AI_BENCH_REQUESTS;
+    long long until = ai_clock_ms() + AI_BENCH_READY_MS;
+    while (!ai_backend()->ready() && ai_clock_ms() < until) {
+        struct timespec ts = {0, 100 * 1000000};
+        nanosleep(&ts, NULL);
+    }
+    if (!ai_backend()->ready()) {
+        printf("AI batch benchmark: backend %s not ready after %d ms\n", ai_backend()->name, AI_BENCH_READY_MS);
+        return;
+    }
+
+    // A different doodle per client, so no two images are identical
+    Raster* rasters = malloc(sizeof(Raster) * clients);
+    if (!rasters) return;
+    for (int i = 0; i < clients; i++) {
+        raster_clear(&rasters[i]);
+        for (int p = 0; p < 64; p++) {
+            raster_apply(&rasters[i], (uint16_t)(100 + (p * (7 + i)) % 600), (uint16_t)(100 + (p * (3 + i)) % 400),
+                         p % 16 == 0 ? 1 : 2, 0, 0, 0);
+        }
+    }
+
+    printf("AI batch benchmark (%s backend, %d clients x %d images):\n", ai_backend()->name, clients, requests);
+    bench_round("unbatched", rasters, clients, requests);
+    ai_batch_start(window_ms, max_batch);
+    bench_round("batched", rasters, clients, requests);
+    pthread_mutex_lock(&batch_mutex);
+    printf("  average batch %.2f images\n", total_batches > 0 ? (double)total_images / total_batches : 0.0);
+    pthread_mutex_unlock(&batch_mutex);
+    free(rasters);
+}
@@ -0,0 +1,36 @@
+#ifndef AI_BATCH_H
+#define AI_BATCH_H
+
+#include "raster.h"
+
+// Micro-batching between the AI threads and the inference backend. Image requests
+// from different rooms are queued; a scheduler thread sends them as one
+// batched call once max_batch are waiting or window_ms has passed since the
+// oldest one arrived, then hands each room its own embedding.
+
+void ai_batch_start(int window_ms, int max_batch);
+
+// Encode one raster (see ai_encode_images()); blocks until the batch
+// containing it is answered, the deadline passes while it is still queued,
+// or ai_batch_cancel(tag) drops it. tag groups requests for cancellation
+// (the server uses the room id). Fails fast while the backend is not ready
+// or the circuit breaker is open, and calls the backend directly if not
+// started.
+int ai_batch_encode_image(const Raster* raster, int tag, long long deadline_ms,
+                          float** out_embedding, int* out_dim);
+
+// Drop every queued request with this tag; requests already sent finish
+// normally
+void ai_batch_cancel(int tag);
+
+// draw_guess_server --bench batch [BACKEND]: AI_BENCH_CLIENTS threads each
+// send AI_BENCH_REQUESTS images through the started backend, first as
+// direct calls and then through the scheduler; prints throughput and
+// p50/p99 latency for both. Leaves batching started.
+#define AI_BENCH_CLIENTS 8
+#define AI_BENCH_REQUESTS 16
+#define AI_BENCH_DEADLINE_MS 30000
+#define AI_BENCH_READY_MS 120000 // wait for the model to load
+void ai_batch_benchmark(int window_ms, int max_batch);
+
+#endif
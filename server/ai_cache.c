@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "metrics.h"
+#include "ai_cache.h"
+
+typedef struct {
+    RasterHash hash;
+    uint32_t set_id;
+    int dim;
+    float* embedding; // NULL when the slot is free
+    unsigned long long last_used;
+} AiCacheEntry;
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static AiCacheEntry* entries = NULL;
+static int capacity = 0;
+static int max_distance = AI_CACHE_DEFAULT_DISTANCE;
+static unsigned long long clock_tick = 0;
+static int configured = 0;
+
+static void ensure_configured(void) {
+    if (!configured) {
+        configured = 1;
+        entries = calloc(AI_CACHE_DEFAULT_SIZE, sizeof(AiCacheEntry));
+        capacity = entries ? AI_CACHE_DEFAULT_SIZE : 0;
+    }
+}
+
+void ai_cache_configure(int size, int distance) {
+    pthread_mutex_lock(&cache_mutex);
+    for (int i = 0; i < capacity; i++) free(entries[i].embedding);
+    free(entries);
+    entries = size > 0 ? calloc(size, sizeof(AiCacheEntry)) : NULL;
+    capacity = entries ? size : 0;
+    max_distance = distance >= 0 ? distance : 0;
+    configured = 1;
+    pthread_mutex_unlock(&cache_mutex);
+    printf("AI cache: %d entries, Hamming tolerance %d\n", capacity, max_distance);
+}
+
+int ai_cache_lookup(const RasterHash* hash, uint32_t set_id, float** out_embedding, int* out_dim) {
+    pthread_mutex_lock(&cache_mutex);
+    ensure_configured();
+    // Closest entry wins; an exact match ends the scan
+    AiCacheEntry* best = NULL;
+    int best_distance = max_distance + 1;
+    for (int i = 0; i < capacity && best_distance > 0; i++) {
+        AiCacheEntry* e = &entries[i];
+        if (!e->embedding || e->set_id != set_id) continue;
+        int d = raster_hash_distance(&e->hash, hash);
+        if (d < best_distance) {
+            best = e;
+            best_distance = d;
+        }
+    }
+
+    float* copy = NULL;
+    if (best) {
+        copy = malloc(sizeof(float) * best->dim);
+        if (copy) {
+            memcpy(copy, best->embedding, sizeof(float) * best->dim);
+            *out_dim = best->dim;
+            best->last_used = ++clock_tick;
+        }
+    }
+    pthread_mutex_unlock(&cache_mutex);
+
+    if (!copy) {
+        metric_inc(METRIC_AI_CACHE_MISSES);
+        return -1;
+    }
+    metric_inc(METRIC_AI_CACHE_HITS);
+    *out_embedding = copy;
+    return 0;
+}
+
+void ai_cache_store(const RasterHash* hash, uint32_t set_id, const float* embedding, int dim) {
+    float* copy = malloc(sizeof(float) * dim);
+    if (!copy) return;
+    memcpy(copy, embedding, sizeof(float) * dim);
+
+    pthread_mutex_lock(&cache_mutex);
+    ensure_configured();
+    if (capacity == 0) {
+        pthread_mutex_unlock(&cache_mutex);
+        free(copy);
+        return;
+    }
+    // Free slot if any, else the least recently used one
+    AiCacheEntry* victim = &entries[0];
+    for (int i = 0; i < capacity; i++) {
+        if (!entries[i].embedding) {
+            victim = &entries[i];
+            break;
+        }
+        if (entries[i].last_used < victim->last_used) victim = &entries[i];
+    }
+    if (victim->embedding) {
+        free(victim->embedding);
+        metric_inc(METRIC_AI_CACHE_EVICTIONS);
+    }
+    victim->hash = *hash;
+    victim->set_id = set_id;
+    victim->dim = dim;
+    victim->embedding = copy;
+    victim->last_used = ++clock_tick;
+    pthread_mutex_unlock(&cache_mutex);
+}
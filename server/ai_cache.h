@@ -0,0 +1,22 @@
+#ifndef AI_CACHE_H
+#define AI_CACHE_H
+
+#include <stdint.h>
+#include "raster.h"
+
+// Bounded LRU of recent image embeddings, keyed by the raster's perceptual
+// hash and the candidate set they were ranked against. A lookup hits when
+// an entry of the same set is within max_distance bits of the hash, so
+// replays and near-identical drawings skip inference.
+
+#define AI_CACHE_DEFAULT_SIZE 256
+#define AI_CACHE_DEFAULT_DISTANCE 3
+
+// capacity 0 disables the cache
+void ai_cache_configure(int capacity, int max_distance);
+
+// On a hit, *out_embedding is a malloc'd copy (caller frees); returns 0
+int ai_cache_lookup(const RasterHash* hash, uint32_t set_id, float** out_embedding, int* out_dim);
+void ai_cache_store(const RasterHash* hash, uint32_t set_id, const float* embedding, int dim);
+
+#endif
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "ai_protocol.h"
+#include "ai_client.h"
+#include "metrics.h"
+
+long long ai_clock_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Wait until fd is ready for events or the deadline passes
+static int wait_fd(int fd, short events, long long deadline_ms) {
+    long long left = deadline_ms - ai_clock_ms();
+    if (left <= 0) return -1;
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    return poll(&pfd, 1, (int)left) == 1 ? 0 : -1;
+}
+
+static int send_all(int fd, const void* buf, size_t len, long long deadline_ms) {
+    const char* p = (const char*)buf;
+    while (len > 0) {
+        if (wait_fd(fd, POLLOUT, deadline_ms) < 0) return -1;
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int recv_all(int fd, void* buf, size_t len, long long deadline_ms) {
+    char* p = (char*)buf;
+    while (len > 0) {
+        if (wait_fd(fd, POLLIN, deadline_ms) < 0) return -1;
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Non-blocking connect, so a wedged service cannot hold the caller past
+// its deadline
+static int ai_connect(long long deadline_ms) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    struct sockaddr_in ai_addr;
+    memset(&ai_addr, 0, sizeof(ai_addr));
+    ai_addr.sin_family = AF_INET;
+    ai_addr.sin_port = htons(AI_SERVICE_PORT);
+    ai_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    int err = 0;
+    socklen_t err_len = sizeof(err);
+    if (connect(fd, (struct sockaddr*)&ai_addr, sizeof(ai_addr)) < 0 &&
+        (errno != EINPROGRESS || wait_fd(fd, POLLOUT, deadline_ms) < 0 ||
+         getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) < 0 || err != 0)) {
+        printf("AI: Failed to connect to AI service on port %d. Is ai_service.py running?\n", AI_SERVICE_PORT);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Send header + payload parts, read the response header and count x dim floats
+static float* ai_call(const AiRequestHeader* req, const void* const* parts, const size_t* part_lens,
+                      int num_parts, long long deadline_ms, AiResponseHeader* resp) {
+    float* data = NULL;
+    int fd = ai_connect(deadline_ms);
+    int sent = fd >= 0 && send_all(fd, req, sizeof(*req), deadline_ms) == 0;
+    for (int i = 0; sent && i < num_parts; i++) {
+        sent = send_all(fd, parts[i], part_lens[i], deadline_ms) == 0;
+    }
+
+    if (sent &&
+        recv_all(fd, resp, sizeof(*resp), deadline_ms) == 0 &&
+        resp->magic == AI_PROTO_MAGIC && resp->status == AI_STATUS_OK && resp->dim > 0) {
+        size_t bytes = sizeof(float) * (size_t)resp->count * resp->dim;
+        data = malloc(bytes ? bytes : 1);
+        if (data && recv_all(fd, data, bytes, deadline_ms) < 0) {
+            free(data);
+            data = NULL;
+        }
+    }
+    if (fd >= 0) close(fd);
+    if (!data) {
+        int timed_out = ai_clock_ms() >= deadline_ms;
+        metric_inc(timed_out ? METRIC_AI_TIMEOUTS : METRIC_AI_FAILURES);
+        printf("AI: Request %d %s\n", req->opcode, timed_out ? "timed out" : "failed");
+    }
+    return data;
+}
+
+static void init_request(AiRequestHeader* req, uint8_t opcode) {
+    memset(req, 0, sizeof(*req));
+    req->magic = AI_PROTO_MAGIC;
+    req->version = AI_PROTO_VERSION;
+    req->opcode = opcode;
+}
+
+static int long_requests = 0;
+
+int ai_long_requests(void) {
+    return __atomic_load_n(&long_requests, __ATOMIC_ACQUIRE);
+}
+
+EmbedIndex* ai_encode_words(uint32_t set_id, const char* block, uint32_t len, uint32_t count) {
+    AiRequestHeader req;
+    init_request(&req, AI_OP_ENCODE_TEXT);
+    req.candidate_set_id = set_id;
+    req.count = count;
+    req.candidates_len = len;
+
+    const void* parts[1] = { block };
+    size_t part_lens[1] = { len };
+    AiResponseHeader resp;
+    long long timeout = AI_TEXT_TIMEOUT_MS + (long long)count * AI_TEXT_TIMEOUT_PER_WORD_MS;
+    __atomic_add_fetch(&long_requests, 1, __ATOMIC_ACQ_REL);
+    float* matrix = ai_call(&req, parts, part_lens, 1, ai_clock_ms() + timeout, &resp);
+    __atomic_sub_fetch(&long_requests, 1, __ATOMIC_ACQ_REL);
+    if (!matrix) return NULL;
+    if (resp.count != count) {
+        free(matrix);
+        return NULL;
+    }
+    char* words = malloc(len ? len : 1);
+    if (!words) {
+        free(matrix);
+        return NULL;
+    }
+    memcpy(words, block, len);
+    printf("AI: Encoded %u words (dim %d) for candidate set %08x\n", count, resp.dim, set_id);
+    return embed_index_create(set_id, (int)count, resp.dim, resp.logit_scale, matrix, words);
+}
+
+int ai_ping(long long deadline_ms) {
+    AiRequestHeader req;
+    init_request(&req, AI_OP_PING);
+
+    AiResponseHeader resp;
+    int fd = ai_connect(deadline_ms);
+    int ok = fd >= 0 &&
+             send_all(fd, &req, sizeof(req), deadline_ms) == 0 &&
+             recv_all(fd, &resp, sizeof(resp), deadline_ms) == 0 &&
+             resp.magic == AI_PROTO_MAGIC && resp.status == AI_STATUS_OK;
+    if (fd >= 0) close(fd);
+    return ok ? 0 : -1;
+}
+
+int ai_encode_images(const Raster* const* rasters, int count, long long deadline_ms,
+                     float** out_embeddings, int* out_dim) {
+    if (count <= 0) return -1;
+    AiRequestHeader req;
+    init_request(&req, AI_OP_ENCODE_IMAGE);
+    req.count = (uint32_t)count;
+    req.width = RASTER_SIZE;
+    req.height = RASTER_SIZE;
+
+    const void** parts = malloc(sizeof(void*) * count);
+    size_t* part_lens = malloc(sizeof(size_t) * count);
+    if (!parts || !part_lens) {
+        free(parts);
+        free(part_lens);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        parts[i] = rasters[i]->planes;
+        part_lens[i] = sizeof(rasters[i]->planes);
+    }
+
+    AiResponseHeader resp;
+    float* embeddings = ai_call(&req, parts, part_lens, count, deadline_ms, &resp);
+    free(parts);
+    free(part_lens);
+    if (!embeddings) return -1;
+    if (resp.count != (uint32_t)count) {
+        free(embeddings);
+        return -1;
+    }
+    *out_embeddings = embeddings;
+    *out_dim = resp.dim;
+    return 0;
+}
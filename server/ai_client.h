@@ -0,0 +1,37 @@
+#ifndef AI_CLIENT_H
+#define AI_CLIENT_H
+
+#include <stdint.h>
+#include "raster.h"
+#include "embed_index.h"
+
+// Blocking calls into ai_service.py (one connection per request). Every
+// call gives up at its deadline, an absolute ai_clock_ms() time.
+
+// Word bank encoding, once per candidate set: a base plus a share per word
+// so large banks get the time they need
+#define AI_TEXT_TIMEOUT_MS 60000
+#define AI_TEXT_TIMEOUT_PER_WORD_MS 10
+
+// Monotonic milliseconds, the time base of all AI deadlines (immune to
+// clock steps; not comparable with time())
+long long ai_clock_ms(void);
+
+// Encode every word of a candidate block (count NUL-terminated words, len
+// bytes). Returns a new index holding a copy of the block, or NULL.
+EmbedIndex* ai_encode_words(uint32_t set_id, const char* block, uint32_t len, uint32_t count);
+
+// Health check; 0 if the service answered in time
+int ai_ping(long long deadline_ms);
+
+// Word encodes currently waiting on the service; the supervisor does not
+// count missed pings against it while one runs
+int ai_long_requests(void);
+
+// Encode count rasters in one call into normalized image embeddings;
+// *out_embeddings is count x *out_dim floats (malloc'd, caller frees), row i
+// for rasters[i]. Returns 0 on success.
+int ai_encode_images(const Raster* const* rasters, int count, long long deadline_ms,
+                     float** out_embeddings, int* out_dim);
+
+#endif
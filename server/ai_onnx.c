@@ -0,0 +1,266 @@
+#ifdef WITH_ONNXRUNTIME
+// In-process inference with ONNX Runtime (build with -DWITH_ONNXRUNTIME and
+// link -lonnxruntime). export_onnx.py writes both files below from the
+// same CLIP checkpoint ai_service.py uses:
+//   model/image_encoder.onnx   pixel_values [N,3,224,224] -> embeds [N,dim]
+//   model/text_embeddings.bin  word embeddings of the word bank
+// The text encoder is not run here and ai_service.py is not started, so
+// the backend does not start without the table, and a word bank with words
+// missing from it gets no index until export_onnx.py is run again.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <onnxruntime_c_api.h>
+#include "ai_client.h"
+#include "ai_backend.h"
+#include "metrics.h"
+
+#define AI_ONNX_MODEL ORT_TSTR("model/image_encoder.onnx")
+#define AI_ONNX_TEXT_TABLE "model/text_embeddings.bin"
+#define AI_ONNX_THREADS 4 // intra-op pool, dedicated to image inference
+
+static const float clip_mean[3] = { 0.48145466f, 0.4578275f, 0.40821073f };
+static const float clip_std[3] = { 0.26862954f, 0.26130258f, 0.27577711f };
+
+static const OrtApi* ort = NULL;
+static OrtEnv* ort_env = NULL;
+static OrtSession* session = NULL;
+static OrtMemoryInfo* cpu_info = NULL;
+static char* input_name = NULL;
+static char* output_name = NULL;
+
+// Exported word embeddings, looked up by word through an open-addressing
+// hash of row indices
+static EmbedTableHeader table;
+static char* table_words = NULL;
+static const char** table_word = NULL;
+static float* table_matrix = NULL;
+static int* table_slots = NULL;
+static uint32_t table_mask = 0;
+
+static int ort_ok(OrtStatus* status, const char* what) {
+    if (!status) return 1;
+    printf("AI onnx: %s failed: %s\n", what, ort->GetErrorMessage(status));
+    ort->ReleaseStatus(status);
+    return 0;
+}
+
+static uint32_t word_hash(const char* s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int table_find(const char* word) {
+    if (!table_slots) return -1;
+    for (uint32_t i = word_hash(word) & table_mask; table_slots[i] >= 0; i = (i + 1) & table_mask) {
+        if (strcmp(table_word[table_slots[i]], word) == 0) return table_slots[i];
+    }
+    return -1;
+}
+
+static int load_text_table(void) {
+    FILE* f = fopen(AI_ONNX_TEXT_TABLE, "rb");
+    if (!f) {
+        printf("AI onnx: %s not found, run export_onnx.py to write it\n", AI_ONNX_TEXT_TABLE);
+        return -1;
+    }
+    int ok = fread(&table, sizeof(table), 1, f) == 1 && table.magic == EMBED_TABLE_MAGIC &&
+             table.count > 0 && table.dim > 0;
+    if (ok) {
+        size_t floats = (size_t)table.count * table.dim;
+        table_words = malloc(table.words_len + 1);
+        table_word = malloc(sizeof(char*) * table.count);
+        table_matrix = malloc(sizeof(float) * floats);
+        ok = table_words && table_word && table_matrix &&
+             fread(table_words, 1, table.words_len, f) == table.words_len &&
+             fread(table_matrix, sizeof(float), floats, f) == floats;
+    }
+    fclose(f);
+
+    uint32_t slots = 1;
+    while (ok && slots < table.count * 2) slots <<= 1;
+    if (ok) table_slots = malloc(sizeof(int) * slots);
+    if (!ok || !table_slots) {
+        printf("AI onnx: %s is invalid, run export_onnx.py to rewrite it\n", AI_ONNX_TEXT_TABLE);
+        free(table_words);
+        free(table_word);
+        free(table_matrix);
+        free(table_slots);
+        table_words = NULL;
+        table_word = NULL;
+        table_matrix = NULL;
+        table_slots = NULL;
+        return -1;
+    }
+    table_words[table.words_len] = '\0';
+    table_mask = slots - 1;
+    memset(table_slots, -1, sizeof(int) * slots);
+
+    const char* p = table_words;
+    for (uint32_t i = 0; i < table.count; i++) {
+        table_word[i] = p;
+        uint32_t h = word_hash(p) & table_mask;
+        while (table_slots[h] >= 0) h = (h + 1) & table_mask;
+        table_slots[h] = (int)i;
+        p += strlen(p) + 1;
+        if (p > table_words + table.words_len) p = table_words + table.words_len;
+    }
+    printf("AI onnx: %u word embeddings (dim %u) loaded\n", table.count, table.dim);
+    return 0;
+}
+
+static int onnx_start(void) {
+    ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+    if (!ort) {
+        printf("AI onnx: ONNX Runtime API version %d not available\n", ORT_API_VERSION);
+        return -1;
+    }
+
+    OrtSessionOptions* options = NULL;
+    OrtAllocator* allocator = NULL;
+    int ok = ort_ok(ort->CreateEnv(ORT_LOGGING_LEVEL_WARNING, "draw_guess", &ort_env), "CreateEnv") &&
+             ort_ok(ort->CreateSessionOptions(&options), "CreateSessionOptions") &&
+             ort_ok(ort->SetIntraOpNumThreads(options, AI_ONNX_THREADS), "SetIntraOpNumThreads") &&
+             ort_ok(ort->SetInterOpNumThreads(options, 1), "SetInterOpNumThreads") &&
+             ort_ok(ort->SetSessionGraphOptimizationLevel(options, ORT_ENABLE_ALL), "SetSessionGraphOptimizationLevel") &&
+             ort_ok(ort->CreateSession(ort_env, AI_ONNX_MODEL, options, &session), "CreateSession") &&
+             ort_ok(ort->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &cpu_info), "CreateCpuMemoryInfo") &&
+             ort_ok(ort->GetAllocatorWithDefaultOptions(&allocator), "GetAllocatorWithDefaultOptions") &&
+             ort_ok(ort->SessionGetInputName(session, 0, allocator, &input_name), "SessionGetInputName") &&
+             ort_ok(ort->SessionGetOutputName(session, 0, allocator, &output_name), "SessionGetOutputName");
+    if (options) ort->ReleaseSessionOptions(options);
+    if (!ok) return -1;
+
+    printf("AI onnx: image encoder loaded (%s -> %s, %d threads)\n", input_name, output_name, AI_ONNX_THREADS);
+    return load_text_table();
+}
+
+static int onnx_ready(void) {
+    return session != NULL;
+}
+
+static uint32_t reported_set_id = 0; // last set logged as incomplete
+
+static EmbedIndex* onnx_encode_words(uint32_t set_id, const char* block, uint32_t len, uint32_t count) {
+    if (!table_matrix) return NULL;
+    float* matrix = malloc(sizeof(float) * (size_t)count * table.dim);
+    if (!matrix) return NULL;
+    const char* p = block;
+    const char* first_missing = NULL;
+    uint32_t missing = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        int row = table_find(p);
+        if (row < 0) {
+            if (!first_missing) first_missing = p;
+            missing++;
+        } else {
+            memcpy(matrix + (size_t)i * table.dim, table_matrix + (size_t)row * table.dim, sizeof(float) * table.dim);
+        }
+        p += strlen(p) + 1;
+    }
+    if (missing > 0) {
+        if (__atomic_exchange_n(&reported_set_id, set_id, __ATOMIC_ACQ_REL) != set_id) {
+            printf("AI onnx: ERROR: %u of %u words (first '%s') are not in %s; the AI stays off"
+                   " for this word bank until export_onnx.py is run again\n",
+                   missing, count, first_missing, AI_ONNX_TEXT_TABLE);
+        }
+        free(matrix);
+        return NULL;
+    }
+
+    char* words = malloc(len ? len : 1);
+    if (!words) {
+        free(matrix);
+        return NULL;
+    }
+    memcpy(words, block, len);
+    return embed_index_create(set_id, (int)count, (int)table.dim, table.logit_scale, matrix, words);
+}
+
+// A Run cannot be interrupted, so the deadline only stops late batches
+// from starting
+static int onnx_encode_images(const Raster* const* rasters, int count, long long deadline_ms,
+                              float** out_embeddings, int* out_dim) {
+    if (count <= 0 || !session) return -1;
+    if (ai_clock_ms() >= deadline_ms) {
+        metric_inc(METRIC_AI_TIMEOUTS);
+        return -1;
+    }
+
+    // uint8 planes -> CLIP-normalized float NCHW
+    size_t floats = (size_t)count * 3 * RASTER_PIXELS;
+    float* pixels = malloc(sizeof(float) * floats);
+    if (!pixels) return -1;
+    for (int n = 0; n < count; n++) {
+        for (int c = 0; c < 3; c++) {
+            const uint8_t* src = rasters[n]->planes[c];
+            float* dst = pixels + ((size_t)n * 3 + c) * RASTER_PIXELS;
+            float scale = 1.0f / (255.0f * clip_std[c]);
+            float bias = -clip_mean[c] / clip_std[c];
+            for (int i = 0; i < RASTER_PIXELS; i++) dst[i] = src[i] * scale + bias;
+        }
+    }
+
+    int64_t shape[4] = { count, 3, RASTER_SIZE, RASTER_SIZE };
+    OrtValue* input = NULL;
+    OrtValue* output = NULL;
+    OrtTensorTypeAndShapeInfo* info = NULL;
+    size_t num_dims = 0;
+    int64_t dims[2] = { 0, 0 };
+    float* data = NULL;
+    const char* input_names[1] = { input_name };
+    const char* output_names[1] = { output_name };
+
+    int ok = ort_ok(ort->CreateTensorWithDataAsOrtValue(cpu_info, pixels, sizeof(float) * floats, shape, 4,
+                                                        ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, &input), "CreateTensor") &&
+             ort_ok(ort->Run(session, NULL, input_names, (const OrtValue* const*)&input, 1,
+                             output_names, 1, &output), "Run") &&
+             ort_ok(ort->GetTensorTypeAndShape(output, &info), "GetTensorTypeAndShape") &&
+             ort_ok(ort->GetDimensionsCount(info, &num_dims), "GetDimensionsCount") &&
+             num_dims == 2 &&
+             ort_ok(ort->GetDimensions(info, dims, 2), "GetDimensions") &&
+             dims[0] == count && dims[1] > 0 &&
+             ort_ok(ort->GetTensorMutableData(output, (void**)&data), "GetTensorMutableData");
+
+    float* embeddings = NULL;
+    if (ok) {
+        int dim = (int)dims[1];
+        embeddings = malloc(sizeof(float) * (size_t)count * dim);
+        for (int n = 0; embeddings && n < count; n++) {
+            // Normalize here too in case the export left that out
+            const float* src = data + (size_t)n * dim;
+            float norm = 0.0f;
+            for (int i = 0; i < dim; i++) norm += src[i] * src[i];
+            norm = norm > 0.0f ? 1.0f / sqrtf(norm) : 0.0f;
+            for (int i = 0; i < dim; i++) embeddings[(size_t)n * dim + i] = src[i] * norm;
+        }
+        *out_dim = dim;
+    }
+
+    if (info) ort->ReleaseTensorTypeAndShapeInfo(info);
+    if (output) ort->ReleaseValue(output);
+    if (input) ort->ReleaseValue(input);
+    free(pixels);
+    if (!embeddings) {
+        metric_inc(METRIC_AI_FAILURES);
+        return -1;
+    }
+    *out_embeddings = embeddings;
+    return 0;
+}
+
+const AiBackend ai_backend_onnx = {
+    "onnx",
+    onnx_start,
+    onnx_ready,
+    onnx_encode_words,
+    onnx_encode_images
+};
+
+#endif
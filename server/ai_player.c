@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "protocol.h"
+#include "ai_player.h"
+
+#define AI_PLAYER_POLL_MS 250 // new seats are picked up within this
+
+typedef enum {
+    SEAT_FREE,
+    SEAT_JOINING,
+    SEAT_WAITING,
+    SEAT_PAINTING,
+    SEAT_GUESSING
+} SeatPhase;
+
+typedef struct {
+    int fd;          // player's end of the socketpair, -1 while it is attached
+    SeatPhase phase;
+    int leave_pending; // asked to leave before the join went out
+    int submitted;   // this round
+    char guess[32];  // held until the guessing phase opens
+    int guess_prob;
+    int final_offered; // the final prediction came, possibly empty
+    char buf[2048];  // partial messages from the server
+    int buf_len;
+} AiPlayerSeat;
+
+static pthread_mutex_t player_mutex = PTHREAD_MUTEX_INITIALIZER;
+static AiPlayerSeat* seats = NULL;
+static int num_seats = 0;
+static int min_confidence = 0;
+static AiPlayerAttach attach_client = NULL;
+
+// Called with player_mutex held, so messages never interleave
+static void seat_send(AiPlayerSeat* seat, void* msg, uint8_t type, size_t size) {
+    BaseMessage* base = (BaseMessage*)msg;
+    base->type = type;
+    base->client_id = 0;
+    base->data_len = (uint16_t)(size - sizeof(BaseMessage));
+    send(seat->fd, msg, size, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+static void seat_ready(AiPlayerSeat* seat) {
+    BaseMessage msg;
+    seat_send(seat, &msg, MSG_CLIENT_READY, sizeof(msg));
+}
+
+static void seat_try_submit(AiPlayerSeat* seat, int room_id) {
+    if (seat->phase != SEAT_GUESSING || seat->submitted || (!seat->guess[0] && !seat->final_offered)) return;
+    GuessSubmitMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    strcpy(msg.guess, seat->guess);
+    seat_send(seat, &msg, MSG_GUESS_SUBMIT, sizeof(msg));
+    seat->submitted = 1;
+    if (seat->guess[0]) printf("AI player room %d: guessed %s (%d%%)\n", room_id, seat->guess, seat->guess_prob);
+    else printf("AI player room %d: no prediction, passed\n", room_id);
+}
+
+static void seat_close(AiPlayerSeat* seat) {
+    close(seat->fd); // the server side sees EOF and removes the client
+    seat->fd = -1;
+    seat->phase = SEAT_FREE;
+}
+
+// Called with player_mutex held
+static void seat_handle(AiPlayerSeat* seat, int room_id, const BaseMessage* msg) {
+    switch (msg->type) {
+        case MSG_ROOM_JOINED:
+            seat->phase = SEAT_WAITING;
+            seat_ready(seat);
+            printf("AI player joined room %d\n", room_id);
+            break;
+        case MSG_ERROR:
+            if (seat->phase == SEAT_JOINING) {
+                printf("AI player could not join room %d\n", room_id);
+                seat_close(seat);
+            }
+            break;
+        case MSG_GAME_START:
+            seat->phase = SEAT_PAINTING;
+            seat->submitted = 0;
+            seat->guess[0] = '\0';
+            seat->guess_prob = 0;
+            seat->final_offered = 0;
+            break;
+        case MSG_PAINTER_FINISH:
+            seat->phase = SEAT_GUESSING;
+            seat_try_submit(seat, room_id);
+            break;
+        case MSG_GAME_END:
+            seat->phase = SEAT_WAITING;
+            seat_ready(seat); // always up for the next round
+            break;
+        case MSG_ROOM_LEFT:
+            printf("AI player left room %d\n", room_id);
+            seat_close(seat);
+            break;
+        default:
+            break;
+    }
+}
+
+// Read what the server sent to one seat and handle every whole message
+static void seat_drain(AiPlayerSeat* seat, int room_id) {
+    ssize_t n = recv(seat->fd, seat->buf + seat->buf_len, sizeof(seat->buf) - seat->buf_len, MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        seat_close(seat);
+        return;
+    }
+    if (n < 0) return;
+    seat->buf_len += (int)n;
+
+    int off = 0;
+    while (seat->fd >= 0 && seat->buf_len - off >= (int)sizeof(BaseMessage)) {
+        const BaseMessage* msg = (const BaseMessage*)(seat->buf + off);
+        int size = (int)sizeof(BaseMessage) + msg->data_len;
+        if (size > (int)sizeof(seat->buf)) {
+            off = seat->buf_len; // nothing the player cares about is this big
+            break;
+        }
+        if (seat->buf_len - off < size) break;
+        seat_handle(seat, room_id, msg);
+        off += size;
+    }
+    if (seat->fd < 0) return;
+    memmove(seat->buf, seat->buf + off, seat->buf_len - off);
+    seat->buf_len -= off;
+}
+
+static void* player_thread(void* arg) {
+    (void)arg;
+    struct pollfd* pfds = malloc(sizeof(struct pollfd) * num_seats);
+    int* rooms_of = malloc(sizeof(int) * num_seats);
+    if (!pfds || !rooms_of) return NULL;
+
+    while (1) {
+        int n = 0;
+        pthread_mutex_lock(&player_mutex);
+        for (int i = 0; i < num_seats; i++) {
+            if (seats[i].phase == SEAT_FREE || seats[i].fd < 0) continue;
+            pfds[n].fd = seats[i].fd;
+            pfds[n].events = POLLIN;
+            pfds[n].revents = 0;
+            rooms_of[n++] = i;
+        }
+        pthread_mutex_unlock(&player_mutex);
+
+        if (poll(pfds, n, AI_PLAYER_POLL_MS) <= 0) continue;
+
+        pthread_mutex_lock(&player_mutex);
+        for (int i = 0; i < n; i++) {
+            AiPlayerSeat* seat = &seats[rooms_of[i]];
+            // Only this thread closes seats, so the fd is still the one polled
+            if (pfds[i].revents && seat->fd == pfds[i].fd) seat_drain(seat, rooms_of[i]);
+        }
+        pthread_mutex_unlock(&player_mutex);
+    }
+    return NULL;
+}
+
+void ai_player_start(int max_rooms, int confidence, AiPlayerAttach attach) {
+    if (confidence <= 0) return;
+    seats = calloc(max_rooms, sizeof(AiPlayerSeat));
+    if (!seats) return;
+    for (int i = 0; i < max_rooms; i++) seats[i].fd = -1;
+    num_seats = max_rooms;
+    min_confidence = confidence;
+    attach_client = attach;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, player_thread, NULL) != 0) {
+        free(seats);
+        seats = NULL;
+        num_seats = 0;
+        return;
+    }
+    pthread_detach(thread);
+    printf("AI player: joins every room, guesses at %d%% confidence\n", confidence);
+}
+
+int ai_player_enabled(void) {
+    return num_seats > 0;
+}
+
+void ai_player_join(int room_id) {
+    if (room_id < 0 || room_id >= num_seats) return;
+    pthread_mutex_lock(&player_mutex);
+    AiPlayerSeat* seat = &seats[room_id];
+    if (seat->phase != SEAT_FREE) {
+        pthread_mutex_unlock(&player_mutex);
+        return;
+    }
+    // Claim the seat, then attach without player_mutex: attaching takes the
+    // server's client lock, which is held while ai_player_leave is called
+    memset(seat, 0, sizeof(*seat));
+    seat->fd = -1;
+    seat->phase = SEAT_JOINING;
+    pthread_mutex_unlock(&player_mutex);
+
+    // Message boundaries are kept where SOCK_SEQPACKET exists; the reader
+    // reassembles either way
+    int fds[2];
+    int attached = 0;
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == 0 ||
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0) {
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        attached = attach_client(fds[1]) >= 0;
+        if (!attached) {
+            close(fds[0]);
+            close(fds[1]);
+            printf("AI player: no client slot for room %d\n", room_id);
+        }
+    }
+
+    pthread_mutex_lock(&player_mutex);
+    if (!attached) {
+        seat->phase = SEAT_FREE;
+        pthread_mutex_unlock(&player_mutex);
+        return;
+    }
+    seat->fd = fds[0];
+    JoinRoomMessage join;
+    memset(&join, 0, sizeof(join));
+    join.room_id = (uint8_t)room_id;
+    strcpy(join.nickname, AI_PLAYER_NICKNAME);
+    seat_send(seat, &join, MSG_JOIN_ROOM, sizeof(join));
+    if (seat->leave_pending) {
+        // The last human left meanwhile: the handler takes these in order
+        LeaveRoomMessage leave;
+        memset(&leave, 0, sizeof(leave));
+        leave.room_id = (uint8_t)room_id;
+        seat_send(seat, &leave, MSG_LEAVE_ROOM, sizeof(leave));
+    }
+    pthread_mutex_unlock(&player_mutex);
+}
+
+void ai_player_leave(int room_id) {
+    if (room_id < 0 || room_id >= num_seats) return;
+    pthread_mutex_lock(&player_mutex);
+    AiPlayerSeat* seat = &seats[room_id];
+    if (seat->phase != SEAT_FREE && seat->fd < 0) {
+        seat->leave_pending = 1; // sent once the join is
+    } else if (seat->phase != SEAT_FREE) {
+        LeaveRoomMessage leave;
+        memset(&leave, 0, sizeof(leave));
+        leave.room_id = (uint8_t)room_id;
+        seat_send(seat, &leave, MSG_LEAVE_ROOM, sizeof(leave));
+    }
+    pthread_mutex_unlock(&player_mutex);
+}
+
+void ai_player_offer(int room_id, const char* word, int prob, int final) {
+    if (room_id < 0 || room_id >= num_seats) return;
+    pthread_mutex_lock(&player_mutex);
+    AiPlayerSeat* seat = &seats[room_id];
+    if (seat->phase == SEAT_PAINTING || seat->phase == SEAT_GUESSING) {
+        // A confident live guess beats the final one; among live guesses
+        // the most confident is kept
+        int take = final ? !seat->guess[0] : (prob >= min_confidence && prob > seat->guess_prob);
+        if (take && !seat->submitted) {
+            strncpy(seat->guess, word, sizeof(seat->guess) - 1);
+            seat->guess[sizeof(seat->guess) - 1] = '\0';
+            seat->guess_prob = prob;
+        }
+        if (final) seat->final_offered = 1;
+        seat_try_submit(seat, room_id);
+    }
+    pthread_mutex_unlock(&player_mutex);
+}
@@ -0,0 +1,34 @@
+#ifndef AI_PLAYER_H
+#define AI_PLAYER_H
+
+// Optional AI player. It joins a room as a pseudo-client over a socketpair
+// whose server end is served by the normal client handler, so it readies
+// up, receives the room broadcasts and submits MSG_GUESS_SUBMIT like any
+// player. Guesses come from the server's predictions (ai_player_offer):
+// a live top-1 at or above the confidence threshold is held until the
+// guessing phase opens and then submitted at once; otherwise the final
+// prediction (or an empty guess without one) is submitted when it
+// arrives. One thread drains every seat.
+
+#define AI_PLAYER_NICKNAME "AI"
+
+// Registers fd as a new client with its handler thread; returns the client
+// id or -1
+typedef int (*AiPlayerAttach)(int fd);
+
+// confidence: minimum live probability in percent; 0 leaves the player off
+void ai_player_start(int max_rooms, int confidence, AiPlayerAttach attach);
+int ai_player_enabled(void);
+
+// Seat a player in the room (asynchronous: it sends MSG_JOIN_ROOM)
+void ai_player_join(int room_id);
+// Make the room's player leave, e.g. when no human is left. Call both
+// without the server's client or room locks held: joining attaches a client.
+void ai_player_leave(int room_id);
+
+// A prediction for the room's current round: top word and its probability
+// in percent. final marks the guessing-phase prediction; an empty final
+// word (no prediction) makes the player pass so the round isn't held up.
+void ai_player_offer(int room_id, const char* word, int prob, int final);
+
+#endif
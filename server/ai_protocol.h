@@ -0,0 +1,97 @@
+#ifndef AI_PROTOCOL_H
+#define AI_PROTOCOL_H
+
+#include <stdint.h>
+
+// Wire format between the game server and ai_service.py.
+// All fields are little-endian and the structs are packed, so the Python
+// side can map them directly with struct / numpy.frombuffer.
+//
+// The service only runs the CLIP encoders. Word embeddings are fetched once
+// per candidate set (AI_OP_ENCODE_TEXT); each round sends just the raster
+// (AI_OP_ENCODE_IMAGE) and the server ranks words itself (embed_index.h).
+// Image requests from several rooms are batched into one call (ai_batch.h).
+
+#define AI_SERVICE_PORT 5000
+#define AI_PROTO_MAGIC 0x49414744u // "DGAI"
+#define AI_PROTO_VERSION 4
+
+typedef enum {
+    AI_OP_ENCODE_TEXT = 1,
+    AI_OP_ENCODE_IMAGE = 2,
+    AI_OP_PING = 3 // health check, answered with an empty OK response
+} AiOpcode;
+
+typedef enum {
+    AI_STATUS_OK = 0,
+    AI_STATUS_ERROR = 1
+} AiStatus;
+
+#pragma pack(push, 1)
+
+// Request: header, then
+//   AI_OP_ENCODE_TEXT:  candidates_len bytes of NUL-terminated words
+//                       (count of them)
+//   AI_OP_ENCODE_IMAGE: count 3 x height x width planar RGB uint8 rasters
+//                       (see raster.h), back to back
+typedef struct {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t opcode;
+    uint16_t reserved;
+    uint32_t candidate_set_id;
+    uint32_t count; // words or images in the payload
+    uint32_t candidates_len;
+    uint16_t width;
+    uint16_t height;
+} AiRequestHeader;
+
+// Response: header, then count x dim float32 L2-normalized embeddings
+// (one per word for ENCODE_TEXT, one per raster for ENCODE_IMAGE)
+typedef struct {
+    uint32_t magic;
+    uint8_t status;
+    uint8_t reserved;
+    uint16_t dim;
+    uint32_t count;
+    float logit_scale; // CLIP temperature, applied to cosine similarities
+} AiResponseHeader;
+
+#pragma pack(pop)
+
+// Same-host transport (ai_shm.c, Linux): a memfd region holding a request
+// ring and a response ring of AI_SHM_SLOTS slots each, shared with the
+// worker through inherited descriptors (AI_SHM_FD, AI_SHM_REQ_EVENT_FD,
+// AI_SHM_RESP_EVENT_FD). Each ring has a single producer and consumer; the
+// producer fills slot[head % slots], then publishes head + 1 and bumps the
+// ring's eventfd, and the consumer advances tail when done with a slot.
+// Request slots carry an AiRequestHeader followed by the payload; response
+// slots an AiResponseHeader followed by the floats. For requests sent this
+// way the header's reserved field is a sequence number, echoed back in the
+// response's reserved byte.
+#define AI_SHM_MAGIC 0x4D484744u // "DGHM"
+#define AI_SHM_SLOTS 4
+#define AI_SHM_MAX_IMAGES 8
+#define AI_SHM_MAX_DIM 1024
+#define AI_SHM_DATA_OFFSET 4096
+
+// Ring indices sit on their own cache lines
+typedef struct {
+    uint32_t magic;
+    uint32_t slots;
+    uint32_t req_slot_size;
+    uint32_t resp_slot_size;
+    uint32_t req_offset;   // from the start of the region
+    uint32_t resp_offset;
+    uint32_t pad0[10];
+    uint32_t req_head;     // written by the server
+    uint32_t pad1[15];
+    uint32_t req_tail;     // written by the worker
+    uint32_t pad2[15];
+    uint32_t resp_head;    // written by the worker
+    uint32_t pad3[15];
+    uint32_t resp_tail;    // written by the server
+    uint32_t pad4[15];
+} AiShmHeader;
+
+#endif
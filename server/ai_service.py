@@ -1,14 +1,40 @@
 import socket
 import struct
-import json
+import numpy as np
 import torch
-from PIL import Image, ImageDraw
 from transformers import CLIPProcessor, CLIPModel
 import os
+import mmap
+import threading
 
 MODEL_PATH = "./model"
 PORT = 5000
 
+# Binary wire format, see ai_protocol.h (little-endian, packed)
+PROTO_MAGIC = 0x49414744
+PROTO_VERSION = 4
+OP_ENCODE_TEXT = 1
+OP_ENCODE_IMAGE = 2
+OP_PING = 3
+STATUS_OK = 0
+STATUS_ERROR = 1
+
+REQUEST_HEADER = struct.Struct('<IBBHIIIHH')
+RESPONSE_HEADER = struct.Struct('<IBBHIf')
+
+# Shared-memory rings (AiShmHeader in ai_protocol.h)
+SHM_MAGIC = 0x4D484744
+SHM_HEADER = struct.Struct('<IIIIII')
+SHM_REQ_HEAD = 64
+SHM_REQ_TAIL = 128
+SHM_RESP_HEAD = 192
+SHM_RESP_TAIL = 256
+TEXT_BATCH = 256
+
+# CLIP image normalization; the server already resized and cropped the raster
+CLIP_MEAN = torch.tensor([0.48145466, 0.4578275, 0.40821073]).view(3, 1, 1)
+CLIP_STD = torch.tensor([0.26862954, 0.26130258, 0.27577711]).view(3, 1, 1)
+
 print(f"Loading CLIP model from {MODEL_PATH}...")
 try:
     model = CLIPModel.from_pretrained(MODEL_PATH)
@@ -18,108 +44,157 @@ except Exception as e:
     print(f"Failed to load model: {e}")
     exit(1)
 
-def reconstruct_image(drawing_data):
-    # Create a white canvas
-    img = Image.new('RGB', (800, 600), 'white')
-    draw = ImageDraw.Draw(img)
-    
-    last_point = None
-    # drawing_data is a list of dicts: {'x': int, 'y': int, 'action': int}
-    # action: 1=Press, 2=Move, 3=Clear
-    
-    for point in drawing_data:
-        x, y, action = point['x'], point['y'], point['action']
-        
-        if action == 1: # Press
-            last_point = (x, y)
-            draw.point((x, y), fill='black')
-        elif action == 2: # Move
-            if last_point:
-                draw.line([last_point, (x, y)], fill='black', width=3)
-            last_point = (x, y)
-        elif action == 3: # Clear
-            draw.rectangle([0, 0, 800, 600], fill='white')
-            last_point = None
-            
-    return img
+def rasters_to_pixel_values(rasters, count, width, height):
+    # count planar RGB uint8 rasters (3 x height x width), already model-sized
+    pixels = torch.from_numpy(np.frombuffer(rasters, dtype=np.uint8).reshape(count, 3, height, width))
+    return pixels.float().div_(255.0).sub_(CLIP_MEAN).div_(CLIP_STD)
+
+def recv_exact(conn, n):
+    buf = bytearray(n)
+    view = memoryview(buf)
+    got = 0
+    while got < n:
+        r = conn.recv_into(view[got:], n - got)
+        if r == 0:
+            raise ConnectionError("connection closed")
+        got += r
+    return buf
+
+def send_embeddings(conn, features):
+    # features: (count, dim) tensor, L2-normalized rows
+    data = features.to(torch.float32).contiguous().numpy()
+    count, dim = data.shape
+    logit_scale = model.logit_scale.exp().item()
+    conn.sendall(RESPONSE_HEADER.pack(PROTO_MAGIC, STATUS_OK, 0, dim, count, logit_scale))
+    conn.sendall(data.tobytes())
+
+def send_error(conn):
+    conn.sendall(RESPONSE_HEADER.pack(PROTO_MAGIC, STATUS_ERROR, 0, 0, 0, 0.0))
+
+def normalize(features):
+    return features / features.norm(dim=-1, keepdim=True)
+
+def encode_words(words):
+    # Encode in batches so large word banks do not blow up memory
+    chunks = []
+    with torch.no_grad():
+        for i in range(0, len(words), TEXT_BATCH):
+            inputs = processor.tokenizer(words[i:i + TEXT_BATCH], return_tensors="pt", padding=True)
+            chunks.append(normalize(model.get_text_features(**inputs)))
+    return torch.cat(chunks)
+
+# Socket connections and the shared-memory ring each run in their own
+# thread; only model calls are serialized, so pings never wait on them
+model_lock = threading.Lock()
+
+def encode_images(pixel_values):
+    # One forward pass for the whole batch
+    with model_lock, torch.no_grad():
+        return normalize(model.get_image_features(pixel_values=pixel_values))
 
 def handle_client(conn):
     try:
-        # Read length of data
-        len_bytes = conn.recv(4)
-        if not len_bytes:
+        header = recv_exact(conn, REQUEST_HEADER.size)
+        (magic, version, opcode, _, set_id, count,
+         candidates_len, width, height) = REQUEST_HEADER.unpack(header)
+        if magic != PROTO_MAGIC or version != PROTO_VERSION:
+            send_error(conn)
             return
-        data_len = struct.unpack('!I', len_bytes)[0]
-        
-        # Read JSON data
-        data_json = b''
-        while len(data_json) < data_len:
-            packet = conn.recv(4096)
-            if not packet: break
-            data_json += packet
-            
-        request = json.loads(data_json.decode('utf-8'))
         
-        drawing_data = request['drawing']
-        candidates = request['candidates'] # List of words
-        target_word = request['target']
-        
-        # Reconstruct image
-        image = reconstruct_image(drawing_data)
-        
-        # Prepare inputs
-        inputs = processor(text=candidates, images=image, return_tensors="pt", padding=True)
-        
-        # Inference
-        with torch.no_grad():
-            outputs = model(**inputs)
-            logits_per_image = outputs.logits_per_image # this is the image-text similarity score
-            probs = logits_per_image.softmax(dim=1) # we can get probabilities
-            
-        # Get result
-        probs_list = probs[0].tolist()
-        best_idx = probs[0].argmax().item()
-        predicted_word = candidates[best_idx]
-        
-        # Calculate similarity score for the target word
-        # CLIP scores are unnormalized logits, but we can use probability or the raw score?
-        # User asked for "percentage as similarity". Probability is good.
-        # But if the set of candidates is small, probability might be skewed.
-        # Let's use the probability of the target word.
-        
-        target_idx = -1
-        if target_word in candidates:
-            target_idx = candidates.index(target_word)
-            
-        target_score = 0
-        if target_idx != -1:
-            target_score = int(probs_list[target_idx] * 100)
-            
-        response = {
-            'predicted_word': predicted_word,
-            'is_correct': 1 if predicted_word == target_word else 0,
-            'score': target_score
-        }
-        
-        # Send response
-        resp_json = json.dumps(response).encode('utf-8')
-        conn.sendall(struct.pack('!I', len(resp_json)))
-        conn.sendall(resp_json)
+        if opcode == OP_ENCODE_TEXT:
+            block = bytes(recv_exact(conn, candidates_len))
+            words = [w.decode('utf-8') for w in block.split(b'\0')[:count]]
+            print(f"Encoding {len(words)} words for candidate set {set_id:08x}")
+            with model_lock:
+                features = encode_words(words)
+            send_embeddings(conn, features)
+        elif opcode == OP_ENCODE_IMAGE:
+            rasters = recv_exact(conn, count * 3 * width * height)
+            send_embeddings(conn, encode_images(rasters_to_pixel_values(rasters, count, width, height)))
+        elif opcode == OP_PING:
+            conn.sendall(RESPONSE_HEADER.pack(PROTO_MAGIC, STATUS_OK, 0, 0, 0, 0.0))
+        else:
+            send_error(conn)
         
     except Exception as e:
         print(f"Error handling request: {e}")
     finally:
         conn.close()
 
+def shm_worker(shm_fd, req_event_fd, resp_event_fd):
+    # Serve image requests from the server's shared-memory rings. Rasters are
+    # read in place from the request slot; the eventfd reads and writes order
+    # the ring index updates against the slot contents.
+    region = mmap.mmap(shm_fd, os.fstat(shm_fd).st_size)
+    magic, slots, req_slot_size, resp_slot_size, req_offset, resp_offset = SHM_HEADER.unpack_from(region, 0)
+    if magic != SHM_MAGIC:
+        print("Shared memory region has the wrong magic, not serving it")
+        return
+    u32 = struct.Struct('<I')
+    print(f"Serving image requests over shared memory ({slots} slots)")
+    
+    while True:
+        os.read(req_event_fd, 8)
+        while True:
+            req_head = u32.unpack_from(region, SHM_REQ_HEAD)[0]
+            req_tail = u32.unpack_from(region, SHM_REQ_TAIL)[0]
+            if req_tail == req_head:
+                break
+            slot = req_offset + (req_tail % slots) * req_slot_size
+            (magic, version, opcode, seq, _, count,
+             _, width, height) = REQUEST_HEADER.unpack_from(region, slot)
+            
+            features = None
+            try:
+                if magic == PROTO_MAGIC and version == PROTO_VERSION and opcode == OP_ENCODE_IMAGE:
+                    rasters = np.frombuffer(region, dtype=np.uint8, count=count * 3 * width * height,
+                                            offset=slot + REQUEST_HEADER.size)
+                    features = encode_images(rasters_to_pixel_values(rasters, count, width, height))
+            except Exception as e:
+                print(f"Error handling shared memory request: {e}")
+            
+            # The server consumes every response before its next request, so
+            # the response ring only fills up if it stopped reading
+            resp_head = u32.unpack_from(region, SHM_RESP_HEAD)[0]
+            if resp_head - u32.unpack_from(region, SHM_RESP_TAIL)[0] < slots:
+                out = resp_offset + (resp_head % slots) * resp_slot_size
+                if features is None:
+                    RESPONSE_HEADER.pack_into(region, out, PROTO_MAGIC, STATUS_ERROR, seq & 0xFF, 0, 0, 0.0)
+                else:
+                    data = features.to(torch.float32).contiguous().numpy()
+                    n, dim = data.shape
+                    logit_scale = model.logit_scale.exp().item()
+                    np.frombuffer(region, dtype=np.float32, count=n * dim,
+                                  offset=out + RESPONSE_HEADER.size)[:] = data.ravel()
+                    RESPONSE_HEADER.pack_into(region, out, PROTO_MAGIC, STATUS_OK, seq & 0xFF, dim, n, logit_scale)
+                u32.pack_into(region, SHM_RESP_HEAD, (resp_head + 1) & 0xFFFFFFFF)
+            u32.pack_into(region, SHM_REQ_TAIL, (req_tail + 1) & 0xFFFFFFFF)
+            os.write(resp_event_fd, (1).to_bytes(8, 'little'))
+
 def main():
     server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
     server.bind(('127.0.0.1', PORT))
-    server.listen(5)
+    server.listen(16)
     print(f"AI Service listening on port {PORT}")
     
+    if "AI_SHM_FD" in os.environ:
+        threading.Thread(target=shm_worker, daemon=True,
+                         args=(int(os.environ["AI_SHM_FD"]),
+                               int(os.environ["AI_SHM_REQ_EVENT_FD"]),
+                               int(os.environ["AI_SHM_RESP_EVENT_FD"]))).start()
+    
+    # Tell the server's supervisor (ai_sidecar.c) we can take requests
+    ready_fd = os.environ.get("AI_READY_FD")
+    if ready_fd:
+        os.write(int(ready_fd), b"READY\n")
+        os.close(int(ready_fd))
+    
+    # One thread per connection: a health check must not queue behind a
+    # word bank encode that can take minutes
     while True:
         conn, addr = server.accept()
-        handle_client(conn)
+        threading.Thread(target=handle_client, args=(conn,), daemon=True).start()
 
 if __name__ == '__main__':
     main()
@@ -0,0 +1,173 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include "ai_protocol.h"
+#include "ai_client.h"
+#include "ai_shm.h"
+#include "metrics.h"
+
+#define REQ_SLOT_SIZE (sizeof(AiRequestHeader) + (size_t)AI_SHM_MAX_IMAGES * 3 * RASTER_PIXELS)
+#define RESP_SLOT_SIZE (sizeof(AiResponseHeader) + (size_t)AI_SHM_MAX_IMAGES * AI_SHM_MAX_DIM * sizeof(float))
+
+static int shm_fd = -1;
+static int req_event_fd = -1;
+static int resp_event_fd = -1;
+static AiShmHeader* shm = NULL;
+static unsigned char* base = NULL;
+static uint16_t next_seq = 0;
+
+// The server side has one producer; the lock only matters when callers
+// bypass the batcher
+static pthread_mutex_t shm_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char env_vars[3][40];
+static const char* env_list[4];
+
+int ai_shm_init(void) {
+    size_t size = AI_SHM_DATA_OFFSET + AI_SHM_SLOTS * (REQ_SLOT_SIZE + RESP_SLOT_SIZE);
+    // No CLOEXEC: the sidecar inherits all three descriptors
+    shm_fd = memfd_create("draw_guess_ai", 0);
+    req_event_fd = eventfd(0, 0);
+    resp_event_fd = eventfd(0, EFD_NONBLOCK);
+    if (shm_fd < 0 || req_event_fd < 0 || resp_event_fd < 0 || ftruncate(shm_fd, (off_t)size) < 0) {
+        printf("AI shm: setup failed: %s\n", strerror(errno));
+        return -1;
+    }
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    if (base == MAP_FAILED) {
+        base = NULL;
+        printf("AI shm: mmap failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    shm = (AiShmHeader*)base;
+    memset(shm, 0, sizeof(*shm));
+    shm->magic = AI_SHM_MAGIC;
+    shm->slots = AI_SHM_SLOTS;
+    shm->req_slot_size = (uint32_t)REQ_SLOT_SIZE;
+    shm->resp_slot_size = (uint32_t)RESP_SLOT_SIZE;
+    shm->req_offset = AI_SHM_DATA_OFFSET;
+    shm->resp_offset = (uint32_t)(AI_SHM_DATA_OFFSET + AI_SHM_SLOTS * REQ_SLOT_SIZE);
+
+    snprintf(env_vars[0], sizeof(env_vars[0]), "AI_SHM_FD=%d", shm_fd);
+    snprintf(env_vars[1], sizeof(env_vars[1]), "AI_SHM_REQ_EVENT_FD=%d", req_event_fd);
+    snprintf(env_vars[2], sizeof(env_vars[2]), "AI_SHM_RESP_EVENT_FD=%d", resp_event_fd);
+    env_list[0] = env_vars[0];
+    env_list[1] = env_vars[1];
+    env_list[2] = env_vars[2];
+    env_list[3] = NULL;
+    printf("AI shm: %zu KB region, %d slots of up to %d images\n", size / 1024, AI_SHM_SLOTS, AI_SHM_MAX_IMAGES);
+    return 0;
+}
+
+const char* const* ai_shm_env(void) {
+    return env_list;
+}
+
+void ai_shm_reset(void) {
+    if (!shm) return;
+    pthread_mutex_lock(&shm_mutex);
+    __atomic_store_n(&shm->req_head, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&shm->req_tail, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&shm->resp_head, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&shm->resp_tail, 0, __ATOMIC_RELEASE);
+    uint64_t drain;
+    while (read(resp_event_fd, &drain, sizeof(drain)) == sizeof(drain)) {}
+    pthread_mutex_unlock(&shm_mutex);
+}
+
+static void signal_event(int fd) {
+    uint64_t one = 1;
+    while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+}
+
+// Wait for the response to seq; returns its slot or NULL at the deadline.
+// Responses to requests that already gave up are skipped.
+static AiResponseHeader* wait_response(uint8_t seq, long long deadline_ms) {
+    while (1) {
+        uint32_t tail = shm->resp_tail;
+        while (tail != __atomic_load_n(&shm->resp_head, __ATOMIC_ACQUIRE)) {
+            AiResponseHeader* resp = (AiResponseHeader*)(base + shm->resp_offset +
+                                                         (size_t)(tail % AI_SHM_SLOTS) * RESP_SLOT_SIZE);
+            if (resp->reserved == seq) return resp;
+            __atomic_store_n(&shm->resp_tail, ++tail, __ATOMIC_RELEASE);
+        }
+
+        long long left = deadline_ms - ai_clock_ms();
+        if (left <= 0) return NULL;
+        struct pollfd pfd;
+        pfd.fd = resp_event_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, (int)left) == 1) {
+            uint64_t count;
+            if (read(resp_event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) return NULL;
+        }
+    }
+}
+
+int ai_shm_encode_images(const Raster* const* rasters, int count, long long deadline_ms,
+                         float** out_embeddings, int* out_dim) {
+    if (!shm || count <= 0 || count > AI_SHM_MAX_IMAGES) return -1;
+
+    pthread_mutex_lock(&shm_mutex);
+    uint32_t head = shm->req_head;
+    if (head - __atomic_load_n(&shm->req_tail, __ATOMIC_ACQUIRE) >= AI_SHM_SLOTS) {
+        pthread_mutex_unlock(&shm_mutex);
+        metric_inc(METRIC_AI_FAILURES);
+        printf("AI shm: request ring full\n");
+        return -1;
+    }
+
+    // Fill the slot in place, then publish it
+    unsigned char* slot = base + shm->req_offset + (size_t)(head % AI_SHM_SLOTS) * REQ_SLOT_SIZE;
+    AiRequestHeader* req = (AiRequestHeader*)slot;
+    uint8_t seq = (uint8_t)++next_seq;
+    memset(req, 0, sizeof(*req));
+    req->magic = AI_PROTO_MAGIC;
+    req->version = AI_PROTO_VERSION;
+    req->opcode = AI_OP_ENCODE_IMAGE;
+    req->reserved = seq;
+    req->count = (uint32_t)count;
+    req->width = RASTER_SIZE;
+    req->height = RASTER_SIZE;
+    unsigned char* payload = slot + sizeof(*req);
+    for (int i = 0; i < count; i++) {
+        memcpy(payload + (size_t)i * sizeof(rasters[i]->planes), rasters[i]->planes, sizeof(rasters[i]->planes));
+    }
+    __atomic_store_n(&shm->req_head, head + 1, __ATOMIC_RELEASE);
+    signal_event(req_event_fd);
+
+    AiResponseHeader* resp = wait_response(seq, deadline_ms);
+    float* embeddings = NULL;
+    if (resp && resp->magic == AI_PROTO_MAGIC && resp->status == AI_STATUS_OK &&
+        resp->count == (uint32_t)count && resp->dim > 0 && resp->dim <= AI_SHM_MAX_DIM) {
+        size_t floats = (size_t)count * resp->dim;
+        embeddings = malloc(sizeof(float) * floats);
+        if (embeddings) {
+            memcpy(embeddings, (unsigned char*)resp + sizeof(*resp), sizeof(float) * floats);
+            *out_dim = resp->dim;
+        }
+    }
+    if (resp) __atomic_store_n(&shm->resp_tail, shm->resp_tail + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&shm_mutex);
+
+    if (!embeddings) {
+        int timed_out = !resp;
+        metric_inc(timed_out ? METRIC_AI_TIMEOUTS : METRIC_AI_FAILURES);
+        printf("AI shm: request %s\n", timed_out ? "timed out" : "failed");
+        return -1;
+    }
+    *out_embeddings = embeddings;
+    return 0;
+}
+
+#endif
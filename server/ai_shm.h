@@ -0,0 +1,27 @@
+#ifndef AI_SHM_H
+#define AI_SHM_H
+
+#include "raster.h"
+
+// Shared-memory transport to ai_service.py (layout in ai_protocol.h).
+// Image batches are written straight into a shared request slot instead of
+// going through a socket; word encoding still uses the socket. Linux only.
+
+#ifdef __linux__
+
+// Create the region and eventfds; 0 on success
+int ai_shm_init(void);
+
+// NULL-terminated environment for the sidecar naming the descriptors
+const char* const* ai_shm_env(void);
+
+// Drop whatever a previous worker left in the rings (before a restart)
+void ai_shm_reset(void);
+
+// Same contract as ai_encode_images()
+int ai_shm_encode_images(const Raster* const* rasters, int count, long long deadline_ms,
+                         float** out_embeddings, int* out_dim);
+
+#endif
+
+#endif
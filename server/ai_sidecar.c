@@ -0,0 +1,192 @@
+#ifndef _WIN32
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "ai_client.h"
+#include "ai_sidecar.h"
+#include "metrics.h"
+
+extern char** environ;
+
+static pid_t sidecar_pid = -1;
+static int sidecar_ready = 0;
+static int supervisor_running = 0;
+static const char* const* sidecar_env = NULL;
+static void (*sidecar_before_spawn)(void) = NULL;
+
+static void sleep_ms(long long ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {}
+}
+
+// Spawn ai_service.py with the write end of a pipe as AI_READY_FD;
+// returns the read end, or -1
+static int spawn_sidecar(void) {
+    int fds[2];
+    if (pipe(fds) < 0) return -1;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+    // environ + AI_READY_FD=<fd> + the caller's extra variables
+    int n = 0;
+    int extra = 0;
+    while (environ[n]) n++;
+    while (sidecar_env && sidecar_env[extra]) extra++;
+    char** envp = malloc(sizeof(char*) * (n + extra + 2));
+    char ready_var[32];
+    if (!envp) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    snprintf(ready_var, sizeof(ready_var), "AI_READY_FD=%d", fds[1]);
+    for (int i = 0; i < n; i++) envp[i] = environ[i];
+    for (int i = 0; i < extra; i++) envp[n + i] = (char*)sidecar_env[i];
+    envp[n + extra] = ready_var;
+    envp[n + extra + 1] = NULL;
+
+    char* argv[] = { "python", "ai_service.py", NULL };
+    pid_t pid;
+    int rc = posix_spawnp(&pid, "python", NULL, NULL, argv, envp);
+    free(envp);
+    close(fds[1]);
+    if (rc != 0) {
+        printf("AI sidecar: failed to spawn python: %s\n", strerror(rc));
+        close(fds[0]);
+        return -1;
+    }
+    __atomic_store_n(&sidecar_pid, pid, __ATOMIC_RELEASE);
+    printf("AI sidecar: started ai_service.py (pid %d), waiting for READY\n", (int)pid);
+    return fds[0];
+}
+
+// Wait for the READY line; 0 on success
+static int wait_ready(int fd) {
+    char line[64];
+    size_t len = 0;
+    long long deadline = ai_clock_ms() + AI_READY_TIMEOUT_MS;
+    while (len < sizeof(line) - 1) {
+        long long left = deadline - ai_clock_ms();
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (left <= 0 || poll(&pfd, 1, (int)left) != 1) {
+            printf("AI sidecar: no READY within %d ms\n", AI_READY_TIMEOUT_MS);
+            return -1;
+        }
+        ssize_t r = read(fd, line + len, sizeof(line) - 1 - len);
+        if (r <= 0) {
+            printf("AI sidecar: exited before it was ready\n");
+            return -1;
+        }
+        len += (size_t)r;
+        line[len] = '\0';
+        if (strchr(line, '\n')) return strncmp(line, "READY", 5) == 0 ? 0 : -1;
+    }
+    return -1;
+}
+
+static int sidecar_alive(void) {
+    pid_t pid = __atomic_load_n(&sidecar_pid, __ATOMIC_ACQUIRE);
+    if (pid <= 0) return 0;
+    if (waitpid(pid, NULL, WNOHANG) == pid) {
+        __atomic_store_n(&sidecar_pid, -1, __ATOMIC_RELEASE);
+        return 0;
+    }
+    return 1;
+}
+
+static void kill_sidecar(void) {
+    pid_t pid = __atomic_exchange_n(&sidecar_pid, -1, __ATOMIC_ACQ_REL);
+    if (pid <= 0) return;
+    kill(pid, SIGTERM);
+    for (int i = 0; i < 20; i++) {
+        if (waitpid(pid, NULL, WNOHANG) == pid) return;
+        sleep_ms(100);
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+}
+
+static void* supervisor_thread(void* arg) {
+    (void)arg;
+    long long backoff = AI_RESTART_BACKOFF_MS;
+    while (__atomic_load_n(&supervisor_running, __ATOMIC_ACQUIRE)) {
+        if (sidecar_before_spawn) sidecar_before_spawn();
+        int ready_fd = spawn_sidecar();
+        int ok = ready_fd >= 0 && wait_ready(ready_fd) == 0;
+        if (ready_fd >= 0) close(ready_fd);
+
+        if (ok) {
+            printf("AI sidecar: ready\n");
+            __atomic_store_n(&sidecar_ready, 1, __ATOMIC_RELEASE);
+            backoff = AI_RESTART_BACKOFF_MS;
+
+            // Health checks until it dies or stops answering
+            int missed = 0;
+            while (__atomic_load_n(&supervisor_running, __ATOMIC_ACQUIRE)) {
+                sleep_ms(AI_HEALTH_INTERVAL_MS);
+                if (!sidecar_alive()) {
+                    printf("AI sidecar: process exited\n");
+                    break;
+                }
+                if (ai_ping(ai_clock_ms() + AI_HEALTH_TIMEOUT_MS) == 0) {
+                    missed = 0;
+                } else if (ai_long_requests() > 0) {
+                    // Busy with a word bank; that request has its own timeout
+                    printf("AI sidecar: health check missed during a word encode, not counted\n");
+                } else if (++missed >= AI_HEALTH_FAILURES) {
+                    printf("AI sidecar: %d health checks missed\n", missed);
+                    break;
+                }
+            }
+            __atomic_store_n(&sidecar_ready, 0, __ATOMIC_RELEASE);
+        }
+
+        kill_sidecar();
+        if (!__atomic_load_n(&supervisor_running, __ATOMIC_ACQUIRE)) break;
+        metric_inc(METRIC_AI_SIDECAR_RESTARTS);
+        printf("AI sidecar: restarting in %lld ms\n", backoff);
+        sleep_ms(backoff);
+        backoff = backoff * 2 < AI_RESTART_BACKOFF_MAX_MS ? backoff * 2 : AI_RESTART_BACKOFF_MAX_MS;
+    }
+    return NULL;
+}
+
+void ai_sidecar_start(const char* const* extra_env, void (*before_spawn)(void)) {
+    if (__atomic_exchange_n(&supervisor_running, 1, __ATOMIC_ACQ_REL)) return;
+    sidecar_env = extra_env;
+    sidecar_before_spawn = before_spawn;
+    pthread_t supervisor;
+    if (pthread_create(&supervisor, NULL, supervisor_thread, NULL) != 0) {
+        printf("AI sidecar: failed to start supervisor\n");
+        __atomic_store_n(&supervisor_running, 0, __ATOMIC_RELEASE);
+        return;
+    }
+    pthread_detach(supervisor);
+}
+
+int ai_sidecar_ready(void) {
+    return __atomic_load_n(&sidecar_ready, __ATOMIC_ACQUIRE);
+}
+
+void ai_sidecar_stop(void) {
+    __atomic_store_n(&supervisor_running, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&sidecar_ready, 0, __ATOMIC_RELEASE);
+    pid_t pid = __atomic_load_n(&sidecar_pid, __ATOMIC_ACQUIRE);
+    if (pid > 0) kill(pid, SIGTERM);
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef AI_SIDECAR_H
+#define AI_SIDECAR_H
+
+// Supervisor for the ai_service.py process behind the python backend.
+// A background thread spawns it with posix_spawn, waits for the READY line
+// it writes to the pipe named by AI_READY_FD once the model is loaded and
+// the port is open, pings it every AI_HEALTH_INTERVAL_MS, and restarts it
+// with exponential backoff when it exits, stops answering or never gets
+// ready. Pings missed while a word encode is in flight (ai_long_requests())
+// are not counted. Until then rounds go on without AI.
+
+#define AI_READY_TIMEOUT_MS 300000  // model loading
+#define AI_HEALTH_INTERVAL_MS 5000
+#define AI_HEALTH_TIMEOUT_MS 5000
+#define AI_HEALTH_FAILURES 3        // missed pings before a restart
+#define AI_RESTART_BACKOFF_MS 1000
+#define AI_RESTART_BACKOFF_MAX_MS 60000
+
+// Returns immediately; the sidecar comes up in the background. extra_env
+// (NULL-terminated "NAME=value" list, kept by reference) is added to its
+// environment, and before_spawn runs ahead of every (re)start.
+void ai_sidecar_start(const char* const* extra_env, void (*before_spawn)(void));
+int ai_sidecar_ready(void);
+// Terminate the sidecar (server shutdown)
+void ai_sidecar_stop(void);
+
+#endif
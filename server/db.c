@@ -0,0 +1,511 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include "db.h"
+#include "metrics.h"
+#include "retention.h"
+
+#define DB_BENCH_PATH "db_bench.db"
+#define DB_BENCH_ROWS 2000
+
+void db_config_defaults(DbConfig* cfg) {
+    strcpy(cfg->journal_mode, "wal");
+    strcpy(cfg->synchronous, "normal");
+    cfg->cache_size = -16384;   // 16 MB
+    cfg->mmap_size = 268435456; // 256 MB
+    cfg->busy_timeout_ms = 5000;
+    cfg->checkpoint_pages = 1000;
+    cfg->checkpoint_interval = 30;
+    cfg->drawing_retention_days = 90;
+    cfg->history_retention_days = 0;
+    cfg->retention_interval = 3600;
+    cfg->retention_batch = 500;
+}
+
+static int one_of(const char* value, const char* const* allowed) {
+    for (; *allowed; allowed++) {
+        if (strcmp(value, *allowed) == 0) return 1;
+    }
+    return 0;
+}
+
+int db_config_load(const char* path, DbConfig* cfg) {
+    static const char* const journal_modes[] = { "wal", "delete", "truncate", "persist", "memory", NULL };
+    static const char* const sync_modes[] = { "off", "normal", "full", "extra", NULL };
+
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    char line[256];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char key[64], value[64];
+        if (sscanf(line, " %63[^= \t] = %63s", key, value) != 2) continue;
+        for (char* p = value; *p; p++) *p = (char)tolower((unsigned char)*p);
+
+        // Text values are whitelisted: they end up in PRAGMA statements
+        if (strcmp(key, "journal_mode") == 0 && one_of(value, journal_modes)) {
+            strcpy(cfg->journal_mode, value);
+        } else if (strcmp(key, "synchronous") == 0 && one_of(value, sync_modes)) {
+            strcpy(cfg->synchronous, value);
+        } else if (strcmp(key, "cache_size") == 0) {
+            cfg->cache_size = atoll(value);
+        } else if (strcmp(key, "mmap_size") == 0) {
+            cfg->mmap_size = atoll(value);
+        } else if (strcmp(key, "busy_timeout") == 0) {
+            cfg->busy_timeout_ms = atoi(value);
+        } else if (strcmp(key, "checkpoint_pages") == 0) {
+            cfg->checkpoint_pages = atoi(value);
+        } else if (strcmp(key, "checkpoint_interval") == 0) {
+            cfg->checkpoint_interval = atoi(value);
+        } else if (strcmp(key, "drawing_retention_days") == 0) {
+            cfg->drawing_retention_days = atoi(value);
+        } else if (strcmp(key, "history_retention_days") == 0) {
+            cfg->history_retention_days = atoi(value);
+        } else if (strcmp(key, "retention_interval") == 0) {
+            cfg->retention_interval = atoi(value);
+        } else if (strcmp(key, "retention_batch") == 0) {
+            cfg->retention_batch = atoi(value);
+        } else {
+            fprintf(stderr, "%s:%d: ignoring %s = %s\n", path, line_no, key, value);
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+int db_configure(sqlite3* conn, const DbConfig* cfg) {
+    char sql[256];
+    snprintf(sql, sizeof(sql),
+             "PRAGMA journal_mode=%s;"
+             "PRAGMA synchronous=%s;"
+             "PRAGMA cache_size=%lld;"
+             "PRAGMA mmap_size=%lld;",
+             cfg->journal_mode, cfg->synchronous, cfg->cache_size, cfg->mmap_size);
+    sqlite3_busy_timeout(conn, cfg->busy_timeout_ms);
+
+    char* err_msg = NULL;
+    if (sqlite3_exec(conn, sql, 0, 0, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "SQL error (pragmas): %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return -1;
+    }
+    return 0;
+}
+
+static pthread_mutex_t ckpt_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ckpt_cond = PTHREAD_COND_INITIALIZER;
+static int wal_pages = 0; // frames in the log after the last commit
+static DbConfig ckpt_cfg;
+static char ckpt_path[256];
+
+// Runs inside every commit on the writer connection. Registering it turns
+// off SQLite's own autocheckpoint, so commits never pay for a checkpoint.
+static int wal_hook(void* arg, sqlite3* conn, const char* name, int pages) {
+    (void)arg;
+    (void)conn;
+    (void)name;
+    pthread_mutex_lock(&ckpt_mutex);
+    wal_pages = pages;
+    if (pages >= ckpt_cfg.checkpoint_pages) pthread_cond_signal(&ckpt_cond);
+    pthread_mutex_unlock(&ckpt_mutex);
+    return SQLITE_OK;
+}
+
+static void* checkpoint_thread(void* arg) {
+    (void)arg;
+    sqlite3* conn;
+    if (sqlite3_open_v2(ckpt_path, &conn, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK) {
+        fprintf(stderr, "DB checkpointer: can't open %s\n", ckpt_path);
+        sqlite3_close(conn);
+        return NULL;
+    }
+    sqlite3_busy_timeout(conn, ckpt_cfg.busy_timeout_ms);
+    // The connection only attaches to the WAL once it has read the database
+    sqlite3_exec(conn, "SELECT count(*) FROM sqlite_master;", 0, 0, 0);
+
+    time_t last = time(NULL);
+    int backlog = 0; // last checkpoint left frames behind
+    while (1) {
+        pthread_mutex_lock(&ckpt_mutex);
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += 1;
+        // A log that could not be fully copied is retried at most once a second
+        if (backlog || wal_pages < ckpt_cfg.checkpoint_pages) {
+            pthread_cond_timedwait(&ckpt_cond, &ckpt_mutex, &until);
+        }
+        int pages = wal_pages;
+        pthread_mutex_unlock(&ckpt_mutex);
+
+        time_t now = time(NULL);
+        if (pages == 0) {
+            last = now;
+            continue;
+        }
+        if (pages < ckpt_cfg.checkpoint_pages && now - last < ckpt_cfg.checkpoint_interval) continue;
+
+        // PASSIVE never blocks the game; a log that keeps outgrowing it
+        // (readers pinning old frames) is truncated once it is 4x the target
+        int mode = pages >= 4 * ckpt_cfg.checkpoint_pages ? SQLITE_CHECKPOINT_TRUNCATE : SQLITE_CHECKPOINT_PASSIVE;
+        int log_frames = 0, done_frames = 0;
+        int rc = sqlite3_wal_checkpoint_v2(conn, NULL, mode, &log_frames, &done_frames);
+        last = now;
+        backlog = 1;
+        if ((rc != SQLITE_OK && rc != SQLITE_BUSY) || log_frames < 0) {
+            fprintf(stderr, "DB checkpoint failed: %s\n", sqlite3_errmsg(conn));
+            continue;
+        }
+        metric_inc(METRIC_DB_CHECKPOINTS);
+        metric_add(METRIC_DB_CHECKPOINT_PAGES, done_frames);
+
+        // Fully copied back: the writer restarts the log on its next commit
+        pthread_mutex_lock(&ckpt_mutex);
+        if (done_frames >= log_frames) {
+            backlog = 0;
+            if (wal_pages == pages) wal_pages = 0;
+        }
+        pthread_mutex_unlock(&ckpt_mutex);
+    }
+    return NULL;
+}
+
+void db_checkpointer_start(sqlite3* conn, const char* path, const DbConfig* cfg) {
+    if (strcmp(cfg->journal_mode, "wal") != 0) return;
+    ckpt_cfg = *cfg;
+    if (ckpt_cfg.checkpoint_pages <= 0) ckpt_cfg.checkpoint_pages = 1000;
+    snprintf(ckpt_path, sizeof(ckpt_path), "%s", path);
+    sqlite3_wal_hook(conn, wal_hook, NULL);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, checkpoint_thread, NULL) != 0) {
+        sqlite3_wal_autocheckpoint(conn, ckpt_cfg.checkpoint_pages); // fall back to inline checkpoints
+        return;
+    }
+    pthread_detach(thread);
+    printf("DB: %s journal, synchronous=%s, checkpoint every %d pages or %ds\n",
+           cfg->journal_mode, cfg->synchronous, ckpt_cfg.checkpoint_pages, ckpt_cfg.checkpoint_interval);
+}
+
+typedef struct {
+    const char* sql;
+    int read;            // prepared on the reader pool, not the writer
+    sqlite3_stmt* stmt;
+    pthread_mutex_t lock;
+} DbStatement;
+
+#define DB_STR_(x) #x
+#define DB_STR(x) DB_STR_(x)
+
+static DbStatement statements[DB_STMT_COUNT] = {
+    [DB_STMT_COUNT_WORDS] = { "SELECT count(*) FROM words;", 1, NULL, PTHREAD_MUTEX_INITIALIZER },
+    [DB_STMT_INSERT_WORD] = { "INSERT OR IGNORE INTO words (word, category, difficulty) VALUES (?, ?, ?);", 0, NULL, PTHREAD_MUTEX_INITIALIZER },
+    [DB_STMT_ALL_WORDS] = { "SELECT word, category, difficulty FROM words ORDER BY category, difficulty, id;", 1, NULL, PTHREAD_MUTEX_INITIALIZER },
+    [DB_STMT_WORDS_VERSION] = { "SELECT version FROM words_version WHERE id = 0;", 1, NULL, PTHREAD_MUTEX_INITIALIZER },
+    [DB_STMT_INSERT_HISTORY] = { "INSERT INTO history (game_id, word, username, user_guess, game_time) VALUES (?, ?, ?, ?, ?);", 0,
+                                 NULL, PTHREAD_MUTEX_INITIALIZER },
+    [DB_STMT_SELECT_HISTORY] = { "SELECT record_id, game_id, word, user_guess, game_time FROM history"
+                                 " WHERE username = ?1 AND record_id < ?2 ORDER BY record_id DESC LIMIT ?3;", 1,
+                                 NULL, PTHREAD_MUTEX_INITIALIZER },
+    [DB_STMT_INSERT_DRAWING] = { "INSERT OR REPLACE INTO drawings (game_id, room_id, word, points, duration_ms, format, data, created_at)"
+                                 " VALUES (?, ?, ?, ?, ?, ?, ?, strftime('%s', 'now'));", 0, NULL, PTHREAD_MUTEX_INITIALIZER },
+    [DB_STMT_ADD_STATS] = { "INSERT INTO player_stats (username, games, wins, guesses, painter_rounds, ai_beaten)"
+                            " VALUES (?1, 1, ?2, ?3, ?4, ?5) ON CONFLICT(username) DO UPDATE SET"
+                            " games = games + 1, wins = wins + ?2, guesses = guesses + ?3,"
+                            " painter_rounds = painter_rounds + ?4, ai_beaten = ai_beaten + ?5;", 0,
+                            NULL, PTHREAD_MUTEX_INITIALIZER },
+    [DB_STMT_ALL_STATS] = { "SELECT username, games, wins, guesses, painter_rounds, ai_beaten FROM player_stats;", 1,
+                            NULL, PTHREAD_MUTEX_INITIALIZER },
+    [DB_STMT_DELETE_DRAWINGS] = { "DELETE FROM drawings WHERE game_id IN"
+                                  " (SELECT game_id FROM drawings WHERE created_at < ?1 ORDER BY created_at LIMIT ?2);", 0,
+                                  NULL, PTHREAD_MUTEX_INITIALIZER },
+    [DB_STMT_HISTORY_HEAD] = { "SELECT record_id, game_time FROM history ORDER BY record_id LIMIT ?;", 1,
+                               NULL, PTHREAD_MUTEX_INITIALIZER },
+    [DB_STMT_DELETE_HISTORY] = { "DELETE FROM history WHERE record_id <= ?;", 0, NULL, PTHREAD_MUTEX_INITIALIZER },
+    [DB_STMT_VACUUM_STEP] = { "PRAGMA incremental_vacuum(" DB_STR(RETENTION_VACUUM_PAGES) ");", 0,
+                              NULL, PTHREAD_MUTEX_INITIALIZER },
+    [DB_STMT_PAGE_STATS] = { "SELECT page_count, freelist_count, page_size, auto_vacuum FROM"
+                             " pragma_page_count(), pragma_freelist_count(), pragma_page_size(), pragma_auto_vacuum();", 1,
+                             NULL, PTHREAD_MUTEX_INITIALIZER },
+};
+
+int db_prepare_statements(sqlite3* conn) {
+    int failed = 0;
+    for (int i = 0; i < DB_STMT_COUNT; i++) {
+        if (statements[i].read) continue;
+        // Long-lived: keep them out of the lookaside allocator
+        if (sqlite3_prepare_v3(conn, statements[i].sql, -1, SQLITE_PREPARE_PERSISTENT,
+                               &statements[i].stmt, NULL) != SQLITE_OK) {
+            fprintf(stderr, "SQL error (prepare %d): %s\n", i, sqlite3_errmsg(conn));
+            statements[i].stmt = NULL;
+            failed = 1;
+        }
+    }
+    return failed ? -1 : 0;
+}
+
+sqlite3_stmt* db_stmt_acquire(DbStmtId id) {
+    pthread_mutex_lock(&statements[id].lock);
+    return statements[id].stmt;
+}
+
+void db_stmt_release(DbStmtId id) {
+    sqlite3_stmt* stmt = statements[id].stmt;
+    if (stmt) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+    pthread_mutex_unlock(&statements[id].lock);
+}
+
+void db_finalize_statements(void) {
+    for (int i = 0; i < DB_STMT_COUNT; i++) {
+        pthread_mutex_lock(&statements[i].lock);
+        sqlite3_finalize(statements[i].stmt);
+        statements[i].stmt = NULL;
+        pthread_mutex_unlock(&statements[i].lock);
+    }
+}
+
+typedef struct {
+    sqlite3* conn;
+    sqlite3_stmt* stmts[DB_STMT_COUNT];
+    int busy;
+} DbReader;
+
+static DbReader readers[DB_READERS];
+static int num_readers = 0;
+static pthread_mutex_t readers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reader_free = PTHREAD_COND_INITIALIZER;
+
+int db_readers_open(const char* path, const DbConfig* cfg) {
+    for (int r = 0; r < DB_READERS; r++) {
+        DbReader* reader = &readers[r];
+        if (sqlite3_open_v2(path, &reader->conn, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+            fprintf(stderr, "DB reader %d: can't open %s: %s\n", r, path, sqlite3_errmsg(reader->conn));
+            sqlite3_close(reader->conn);
+            reader->conn = NULL;
+            break;
+        }
+        // journal_mode and synchronous belong to the writer
+        char sql[96];
+        snprintf(sql, sizeof(sql), "PRAGMA cache_size=%lld; PRAGMA mmap_size=%lld;", cfg->cache_size, cfg->mmap_size);
+        sqlite3_exec(reader->conn, sql, 0, 0, 0);
+        sqlite3_busy_timeout(reader->conn, cfg->busy_timeout_ms);
+        for (int i = 0; i < DB_STMT_COUNT; i++) {
+            if (!statements[i].read) continue;
+            if (sqlite3_prepare_v3(reader->conn, statements[i].sql, -1, SQLITE_PREPARE_PERSISTENT,
+                                   &reader->stmts[i], NULL) != SQLITE_OK) {
+                fprintf(stderr, "SQL error (prepare %d, reader %d): %s\n", i, r, sqlite3_errmsg(reader->conn));
+                reader->stmts[i] = NULL;
+            }
+        }
+        num_readers++;
+    }
+    return num_readers > 0 ? 0 : -1;
+}
+
+sqlite3_stmt* db_read_acquire(DbStmtId id) {
+    pthread_mutex_lock(&readers_mutex);
+    DbReader* reader = NULL;
+    while (num_readers > 0 && !reader) {
+        for (int r = 0; r < num_readers && !reader; r++) {
+            if (!readers[r].busy) reader = &readers[r];
+        }
+        if (!reader) pthread_cond_wait(&reader_free, &readers_mutex);
+    }
+    sqlite3_stmt* stmt = reader ? reader->stmts[id] : NULL;
+    if (stmt) reader->busy = 1;
+    pthread_mutex_unlock(&readers_mutex);
+    return stmt;
+}
+
+void db_read_release(sqlite3_stmt* stmt) {
+    if (!stmt) return;
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    sqlite3* conn = sqlite3_db_handle(stmt);
+    pthread_mutex_lock(&readers_mutex);
+    for (int r = 0; r < num_readers; r++) {
+        if (readers[r].conn == conn) readers[r].busy = 0;
+    }
+    pthread_cond_signal(&reader_free);
+    pthread_mutex_unlock(&readers_mutex);
+}
+
+void db_readers_close(void) {
+    pthread_mutex_lock(&readers_mutex);
+    for (int r = 0; r < num_readers; r++) {
+        while (readers[r].busy) pthread_cond_wait(&reader_free, &readers_mutex);
+        for (int i = 0; i < DB_STMT_COUNT; i++) sqlite3_finalize(readers[r].stmts[i]);
+        sqlite3_close(readers[r].conn);
+        memset(&readers[r], 0, sizeof(readers[r]));
+    }
+    num_readers = 0;
+    pthread_cond_broadcast(&reader_free);
+    pthread_mutex_unlock(&readers_mutex);
+}
+
+static pthread_mutex_t write_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t write_queued = PTHREAD_COND_INITIALIZER;
+static DbWrite* write_head = NULL;
+static DbWrite* write_tail = NULL;
+static sqlite3* writer_conn = NULL;
+static pthread_t writer_tid;
+static int writer_running = 0;
+static int writer_stopping = 0;
+
+// One transaction for a chain of jobs; savepoints keep a failed job's
+// changes out without losing the others
+static void apply_writes(DbWrite* batch) {
+    int ok[DB_WRITE_BATCH];
+    int n = 0;
+    int committed = sqlite3_exec(writer_conn, "BEGIN IMMEDIATE;", 0, 0, 0) == SQLITE_OK;
+    for (DbWrite* w = batch; w; w = w->next, n++) {
+        ok[n] = 0;
+        if (!committed || sqlite3_exec(writer_conn, "SAVEPOINT job;", 0, 0, 0) != SQLITE_OK) continue;
+        ok[n] = w->apply(w) == 0;
+        if (!ok[n]) sqlite3_exec(writer_conn, "ROLLBACK TO job;", 0, 0, 0);
+        sqlite3_exec(writer_conn, "RELEASE job;", 0, 0, 0);
+    }
+    if (committed && sqlite3_exec(writer_conn, "COMMIT;", 0, 0, 0) != SQLITE_OK) {
+        sqlite3_exec(writer_conn, "ROLLBACK;", 0, 0, 0);
+        committed = 0;
+    }
+    if (!committed) fprintf(stderr, "SQL error (write batch of %d): %s\n", n, sqlite3_errmsg(writer_conn));
+    metric_inc(METRIC_DB_WRITE_TXNS);
+    metric_add(METRIC_DB_WRITES, n);
+
+    n = 0;
+    for (DbWrite* w = batch; w; n++) {
+        DbWrite* next = w->next; // done() may free w
+        w->done(w, committed && ok[n]);
+        w = next;
+    }
+}
+
+// Detach up to DB_WRITE_BATCH jobs from the queue; caller holds write_mutex
+static DbWrite* take_writes(void) {
+    DbWrite* batch = write_head;
+    DbWrite* last = batch;
+    for (int n = 1; n < DB_WRITE_BATCH && last->next; n++) last = last->next;
+    write_head = last->next;
+    if (!write_head) write_tail = NULL;
+    last->next = NULL;
+    return batch;
+}
+
+static void* writer_thread(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&write_mutex);
+    while (1) {
+        while (!write_head && !writer_stopping) pthread_cond_wait(&write_queued, &write_mutex);
+        if (!write_head) {
+            writer_running = 0; // later jobs run inline
+            break;
+        }
+        DbWrite* batch = take_writes();
+        pthread_mutex_unlock(&write_mutex);
+        apply_writes(batch);
+        pthread_mutex_lock(&write_mutex);
+    }
+    pthread_mutex_unlock(&write_mutex);
+    return NULL;
+}
+
+void db_writer_start(sqlite3* conn) {
+    writer_conn = conn;
+    writer_running = pthread_create(&writer_tid, NULL, writer_thread, NULL) == 0;
+}
+
+void db_write(DbWrite* w) {
+    w->next = NULL;
+    pthread_mutex_lock(&write_mutex);
+    if (!writer_running) {
+        // No thread: apply it here, still one writer at a time
+        apply_writes(w);
+        pthread_mutex_unlock(&write_mutex);
+        return;
+    }
+    if (write_tail) write_tail->next = w;
+    else write_head = w;
+    write_tail = w;
+    pthread_cond_signal(&write_queued);
+    pthread_mutex_unlock(&write_mutex);
+}
+
+void db_writer_stop(void) {
+    pthread_mutex_lock(&write_mutex);
+    int running = writer_running;
+    writer_stopping = 1;
+    pthread_cond_signal(&write_queued);
+    pthread_mutex_unlock(&write_mutex);
+    // From a signal handler that interrupted the writer itself, don't wait on it
+    if (running && !pthread_equal(writer_tid, pthread_self())) pthread_join(writer_tid, NULL);
+}
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_remove(void) {
+    remove(DB_BENCH_PATH);
+    remove(DB_BENCH_PATH "-wal");
+    remove(DB_BENCH_PATH "-shm");
+    remove(DB_BENCH_PATH "-journal");
+}
+
+// One autocommit INSERT per row, like the paint handler; returns rows/s
+static double bench_inserts(const DbConfig* cfg) {
+    bench_remove();
+    sqlite3* conn;
+    if (sqlite3_open(DB_BENCH_PATH, &conn) != SQLITE_OK) {
+        sqlite3_close(conn);
+        return 0.0;
+    }
+    sqlite3_stmt* stmt = NULL;
+    double rate = 0.0;
+    if (db_configure(conn, cfg) == 0 &&
+        sqlite3_exec(conn, "CREATE TABLE drawing_data (id INTEGER PRIMARY KEY AUTOINCREMENT, game_id INTEGER,"
+                           " x INTEGER, y INTEGER, action INTEGER, color_r INTEGER, color_g INTEGER,"
+                           " color_b INTEGER, timestamp INTEGER);", 0, 0, 0) == SQLITE_OK &&
+        sqlite3_prepare_v2(conn, "INSERT INTO drawing_data (game_id, x, y, action, color_r, color_g, color_b, timestamp)"
+                                 " VALUES (1, ?, ?, 2, 0, 0, 0, ?);", -1, &stmt, 0) == SQLITE_OK) {
+        double t0 = bench_now();
+        for (int i = 0; i < DB_BENCH_ROWS; i++) {
+            sqlite3_bind_int(stmt, 1, i % 800);
+            sqlite3_bind_int(stmt, 2, i % 600);
+            sqlite3_bind_int64(stmt, 3, (sqlite3_int64)time(NULL));
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+        rate = DB_BENCH_ROWS / (bench_now() - t0);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(conn);
+    bench_remove();
+    return rate;
+}
+
+void db_benchmark(const DbConfig* cfg) {
+    DbConfig before;
+    db_config_defaults(&before);
+    strcpy(before.journal_mode, "delete");
+    strcpy(before.synchronous, "full");
+    before.cache_size = -2000; // SQLite's defaults
+    before.mmap_size = 0;
+
+    double old_rate = bench_inserts(&before);
+    double new_rate = bench_inserts(cfg);
+    printf("DB insert benchmark (%d single-row transactions in %s):\n", DB_BENCH_ROWS, DB_BENCH_PATH);
+    printf("  %-8s synchronous=%-6s %10.0f rows/s\n", before.journal_mode, before.synchronous, old_rate);
+    printf("  %-8s synchronous=%-6s %10.0f rows/s  (%.1fx)\n", cfg->journal_mode, cfg->synchronous, new_rate,
+           old_rate > 0.0 ? new_rate / old_rate : 0.0);
+}
@@ -0,0 +1,107 @@
+#ifndef DB_H
+#define DB_H
+
+#include "sqlite3.h"
+
+// game_data.db connection tuning. Settings come from a small "key = value"
+// file (db.conf next to the database; missing file or keys keep the
+// defaults below). In WAL mode the automatic checkpoint is replaced by a
+// background thread that checkpoints from its own connection once the log
+// reaches checkpoint_pages or checkpoint_interval seconds have passed.
+// The retention keys drive the background job in retention.h.
+
+#define DB_PATH "game_data.db"
+#define DB_CONFIG_PATH "db.conf"
+
+typedef struct {
+    char journal_mode[16];   // wal, delete, truncate, persist, memory
+    char synchronous[16];    // off, normal, full, extra
+    long long cache_size;    // pages, or KiB when negative (PRAGMA cache_size)
+    long long mmap_size;     // bytes
+    int busy_timeout_ms;
+    int checkpoint_pages;    // WAL frames that trigger a checkpoint
+    int checkpoint_interval; // seconds between checkpoints of a non-empty log
+    int drawing_retention_days; // 0 = keep forever
+    int history_retention_days; // 0 = keep forever
+    int retention_interval;  // seconds between retention passes
+    int retention_batch;     // rows per delete transaction
+} DbConfig;
+
+void db_config_defaults(DbConfig* cfg);
+// Override cfg from the file; returns 0 if it was read
+int db_config_load(const char* path, DbConfig* cfg);
+
+// Apply the pragmas to a freshly opened connection
+int db_configure(sqlite3* conn, const DbConfig* cfg);
+
+// Hook the writer connection and start the checkpoint thread (WAL only)
+void db_checkpointer_start(sqlite3* conn, const char* path, const DbConfig* cfg);
+
+// Statement registry: every SQL statement the server runs more than once,
+// prepared a single time after the schema exists. Values are always bound,
+// never formatted into SQL text.
+//
+// Writes are prepared on the writer connection: acquire() locks the
+// statement for the calling thread; release() resets it, clears its
+// bindings and unlocks it. Reads (marked R) are prepared on each
+// connection of the reader pool instead.
+typedef enum {
+    DB_STMT_COUNT_WORDS,     // R
+    DB_STMT_INSERT_WORD,     // ?1 word ?2 category ?3 difficulty
+    DB_STMT_ALL_WORDS,       // R
+    DB_STMT_WORDS_VERSION,   // R
+    DB_STMT_INSERT_HISTORY,  // ?1 game_id ?2 word ?3 username ?4 user_guess ?5 game_time
+    DB_STMT_SELECT_HISTORY,  // R ?1 username ?2 before record_id ?3 limit
+    DB_STMT_INSERT_DRAWING,  // ?1 game_id ?2 room_id ?3 word ?4 points ?5 duration_ms ?6 format ?7 data
+    DB_STMT_ADD_STATS,       // ?1 username ?2 wins ?3 guesses ?4 painter_rounds ?5 ai_beaten (games + 1)
+    DB_STMT_ALL_STATS,       // R
+    DB_STMT_DELETE_DRAWINGS, // ?1 created_at cutoff ?2 limit (oldest first)
+    DB_STMT_HISTORY_HEAD,    // R ?1 limit (oldest record_id first)
+    DB_STMT_DELETE_HISTORY,  // ?1 last record_id to delete
+    DB_STMT_VACUUM_STEP,     // PRAGMA incremental_vacuum(RETENTION_VACUUM_PAGES)
+    DB_STMT_PAGE_STATS,      // R page_count, freelist_count, page_size, auto_vacuum
+    DB_STMT_COUNT
+} DbStmtId;
+
+// Write statements, on the writer connection (startup, offline tools and
+// DbWrite jobs)
+int db_prepare_statements(sqlite3* conn);
+sqlite3_stmt* db_stmt_acquire(DbStmtId id); // NULL if it failed to prepare (still locked)
+void db_stmt_release(DbStmtId id);
+void db_finalize_statements(void);
+
+// Reader pool: DB_READERS read-only connections with the R statements
+// prepared on each. acquire() takes a free connection (waiting while all
+// are in use) and returns its statement; release() resets it and hands
+// the connection back. Hold one at a time per thread. In WAL mode a read
+// sees the last commit and never waits for the writer.
+#define DB_READERS 4
+
+int db_readers_open(const char* path, const DbConfig* cfg);
+sqlite3_stmt* db_read_acquire(DbStmtId id); // NULL if not available (nothing held)
+void db_read_release(sqlite3_stmt* stmt);
+void db_readers_close(void);
+
+// Writer: one thread owns the writer connection and applies queued jobs in
+// order, up to DB_WRITE_BATCH of them per transaction, each inside its own
+// savepoint so a failing job rolls back alone. Callers never wait for the
+// disk; done() learns whether the job's changes were committed.
+#define DB_WRITE_BATCH 32
+
+typedef struct DbWrite {
+    int (*apply)(struct DbWrite* w);         // writer thread, inside the transaction; 0 keeps its changes
+    void (*done)(struct DbWrite* w, int ok); // after the commit; owns w
+    struct DbWrite* next;
+} DbWrite;
+
+// Start the writer thread on conn (jobs run inline if it can't start)
+void db_writer_start(sqlite3* conn);
+void db_write(DbWrite* w);
+// Apply everything queued, then stop the thread (shutdown)
+void db_writer_stop(void);
+
+// draw_guess_server --bench db: drawing_data-style single-row inserts,
+// default rollback journal vs cfg
+void db_benchmark(const DbConfig* cfg);
+
+#endif
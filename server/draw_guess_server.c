@@ -1,7 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -9,6 +13,22 @@
 #include <time.h>
 #include <signal.h>
 #include "protocol.h"
+#include "ai_client.h"
+#include "ai_backend.h"
+#include "ai_sidecar.h"
+#include "ai_batch.h"
+#include "ai_cache.h"
+#include "ai_player.h"
+#include "metrics.h"
+#include "db.h"
+#include "word_bank.h"
+#include "stroke_buffer.h"
+#include "drawing_store.h"
+#include "leaderboard.h"
+#include "replay.h"
+#include "retention.h"
+#include "raster.h"
+#include "raster_kernels.h"
 #include "sqlite3.h"
 
 #define MAX_CLIENTS 10
@@ -26,6 +46,7 @@ typedef struct {
     struct sockaddr_in udp_addr;
     int has_udp_addr;
     int room_id; // Add room_id to ClientInfo
+    int is_ai;   // AI player pseudo-client (ai_player.h)
 } ClientInfo;
 
 // Game information
@@ -42,22 +63,41 @@ typedef struct {
 
 // Add room struct
 #define MAX_ROOMS 10
-#define MAX_DRAWING_POINTS 4096
+#define MAX_AI_CLIENTS MAX_ROOMS // AI player seats, in slots after the human ones
+#define MAX_CONNECTIONS (MAX_CLIENTS + MAX_AI_CLIENTS)
+#define ROOM_SLOTS (MAX_CLIENTS + 1) // every human plus the AI player
 
-typedef struct {
-    uint16_t x;
-    uint16_t y;
-    uint8_t action;
-} DrawingPoint;
+#define PAINT_PHASE_SECONDS 60
+#define GUESS_PHASE_SECONDS 30
+
+// Live AI predictions during the painting phase
+#define AI_LIVE_EVERY_POINTS 48
+#define AI_LIVE_INTERVAL_MS 1500
+#define AI_LIVE_MAX_INFLIGHT 1
+#define AI_LIVE_MAX_TOTAL (2 * AI_BATCH_MAX) // across rooms, so final predictions never queue far behind
+#define AI_ROOM_BUDGET_MS 8000 // live prediction time per room and round
+
+// Cross-room batching of image requests (ai_batch.h). The window is small
+// next to the 30s guessing phase.
+#define AI_BATCH_WINDOW_MS 20
+#define AI_BATCH_MAX 8 // at most AI_SHM_MAX_IMAGES for the python-shm backend
+
+#define METRICS_LOG_INTERVAL 60 // seconds
 
 typedef struct {
     uint8_t id;
     char name[32];
-    ClientInfo clients[MAX_CLIENTS];
+    ClientInfo clients[ROOM_SLOTS];
     GameInfo game;
     int client_count;
-    DrawingPoint drawing_history[MAX_DRAWING_POINTS];
-    int history_count;
+    StrokeBuffer strokes; // this round's points, empty between rounds
+    WordBag word_bag;
+    // Raster kept up to date while painting, for live AI predictions
+    Raster* live_raster;
+    int live_points;       // points since the last live prediction
+    long long live_last_ms;
+    int live_inflight;
+    long long ai_spent_ms; // live prediction time this round, against AI_ROOM_BUDGET_MS
     // AI prediction result (stored but not broadcast until all clients submit)
     char ai_predicted_word[32];
     uint8_t ai_score;
@@ -68,30 +108,68 @@ typedef struct {
 Room rooms[MAX_ROOMS];
 pthread_mutex_t rooms_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-ClientInfo clients[MAX_CLIENTS];
+// Players in the room other than the AI player
+int room_human_count(const Room* room) {
+    int humans = 0;
+    for (int i = 0; i < ROOM_SLOTS; i++) {
+        if (room->clients[i].socket_fd != -1 && !room->clients[i].is_ai) humans++;
+    }
+    return humans;
+}
+
+ClientInfo clients[MAX_CONNECTIONS];
     GameInfo game; // Kept for struct definition, not used as global
 pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Every TCP send to a client goes through its sender, so frames from the
+// handler, broadcasts and replays never interleave. conn changes each time
+// the slot is reused, so a late replay frame can't reach the next client.
+typedef struct {
+    pthread_mutex_t mutex;
+    int fd; // -1 once the client is gone
+    unsigned conn;
+} ClientSender;
+ClientSender senders[MAX_CONNECTIONS];
+#define SEND_PARTIAL_MS 200 // to finish a replay frame the socket took part of
+int send_to_client(int client_id, const void* buf, size_t len);
+int live_inflight_total = 0; // under rooms_mutex
 int udp_socket;
 int tcp_socket;
 int running = 1;
 sqlite3 *db;
+const char* db_config_path = DB_CONFIG_PATH;
+DbConfig db_settings; // as loaded by init_db
 
 // Initialize Database
 void init_db() {
-    int rc = sqlite3_open("game_data.db", &db);
+    int rc = sqlite3_open(DB_PATH, &db);
     if (rc) {
         fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
         exit(1);
     } else {
         printf("Opened database successfully\n");
     }
+    
+    DbConfig db_cfg;
+    db_config_defaults(&db_cfg);
+    if (db_config_load(db_config_path, &db_cfg) != 0) {
+        printf("No %s, using default database settings\n", db_config_path);
+    }
+    // Only takes effect on a new file (--compact-db converts an old one),
+    // so the retention job can give freed pages back
+    sqlite3_exec(db, "PRAGMA auto_vacuum=INCREMENTAL;", 0, 0, 0);
+    db_configure(db, &db_cfg);
+    db_checkpointer_start(db, DB_PATH, &db_cfg);
+    db_settings = db_cfg;
 
     char *err_msg = 0;
     
     // Create words table
     const char *sql_words = "CREATE TABLE IF NOT EXISTS words ("
                             "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-                            "word TEXT UNIQUE NOT NULL);";
+                            "word TEXT UNIQUE NOT NULL,"
+                            "category TEXT NOT NULL DEFAULT 'general',"
+                            "difficulty INTEGER NOT NULL DEFAULT 1,"
+                            "language TEXT NOT NULL DEFAULT 'en');";
                             
     rc = sqlite3_exec(db, sql_words, 0, 0, &err_msg);
     if (rc != SQLITE_OK) {
@@ -99,6 +177,48 @@ void init_db() {
         sqlite3_free(err_msg);
     }
 
+    // Databases from before categories only have (id, word)
+    sqlite3_stmt *info;
+    int has_category = 0;
+    if (sqlite3_prepare_v2(db, "PRAGMA table_info(words);", -1, &info, NULL) == SQLITE_OK) {
+        while (sqlite3_step(info) == SQLITE_ROW) {
+            if (strcmp((const char*)sqlite3_column_text(info, 1), "category") == 0) has_category = 1;
+        }
+        sqlite3_finalize(info);
+    }
+    if (!has_category) {
+        printf("Adding category, difficulty and language to words...\n");
+        rc = sqlite3_exec(db,
+                          "ALTER TABLE words ADD COLUMN category TEXT NOT NULL DEFAULT 'general';"
+                          "ALTER TABLE words ADD COLUMN difficulty INTEGER NOT NULL DEFAULT 1;"
+                          "ALTER TABLE words ADD COLUMN language TEXT NOT NULL DEFAULT 'en';",
+                          0, 0, &err_msg);
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "SQL error (migrate words): %s\n", err_msg);
+            sqlite3_free(err_msg);
+        }
+    }
+
+    // Version of the word bank, bumped by triggers on every change to words
+    // so the AI candidate set can be refreshed without diffing the table
+    const char *sql_words_version =
+        "CREATE TABLE IF NOT EXISTS words_version ("
+        "id INTEGER PRIMARY KEY CHECK (id = 0),"
+        "version INTEGER NOT NULL);"
+        "INSERT OR IGNORE INTO words_version (id, version) VALUES (0, 1);"
+        "CREATE TRIGGER IF NOT EXISTS words_version_insert AFTER INSERT ON words "
+        "BEGIN UPDATE words_version SET version = version + 1; END;"
+        "CREATE TRIGGER IF NOT EXISTS words_version_update AFTER UPDATE ON words "
+        "BEGIN UPDATE words_version SET version = version + 1; END;"
+        "CREATE TRIGGER IF NOT EXISTS words_version_delete AFTER DELETE ON words "
+        "BEGIN UPDATE words_version SET version = version + 1; END;";
+
+    rc = sqlite3_exec(db, sql_words_version, 0, 0, &err_msg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error (create words_version): %s\n", err_msg);
+        sqlite3_free(err_msg);
+    }
+
     // Create history table
     const char *sql_history = "CREATE TABLE IF NOT EXISTS history ("
                               "record_id INTEGER PRIMARY KEY AUTOINCREMENT,"
@@ -114,75 +234,206 @@ void init_db() {
         sqlite3_free(err_msg);
     }
 
-    // Create drawing_data table
-    const char *sql_drawing = "CREATE TABLE IF NOT EXISTS drawing_data ("
-                              "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-                              "game_id INTEGER,"
-                              "x INTEGER,"
-                              "y INTEGER,"
-                              "action INTEGER,"
-                              "color_r INTEGER,"
-                              "color_g INTEGER,"
-                              "color_b INTEGER,"
-                              "timestamp INTEGER);";
+    // Per-player totals, updated by end_game, mirrored by leaderboard.h
+    const char *sql_stats = "CREATE TABLE IF NOT EXISTS player_stats ("
+                            "username TEXT PRIMARY KEY,"
+                            "games INTEGER NOT NULL DEFAULT 0,"
+                            "wins INTEGER NOT NULL DEFAULT 0,"
+                            "guesses INTEGER NOT NULL DEFAULT 0,"
+                            "painter_rounds INTEGER NOT NULL DEFAULT 0,"
+                            "ai_beaten INTEGER NOT NULL DEFAULT 0);";
+    
+    rc = sqlite3_exec(db, sql_stats, 0, 0, &err_msg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error (create player_stats): %s\n", err_msg);
+        sqlite3_free(err_msg);
+    }
+
+    // History is always read per user, newest first, by record_id cursor
+    rc = sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS history_user_record ON history (username, record_id);",
+                      0, 0, &err_msg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error (create history index): %s\n", err_msg);
+        sqlite3_free(err_msg);
+    }
+
+    // Create drawings table: one packed stroke stream per round (drawing_store.h)
+    const char *sql_drawing = "CREATE TABLE IF NOT EXISTS drawings ("
+                              "game_id INTEGER PRIMARY KEY,"
+                              "room_id INTEGER,"
+                              "word TEXT,"
+                              "points INTEGER,"
+                              "duration_ms INTEGER,"
+                              "format INTEGER,"
+                              "data BLOB,"
+                              "created_at INTEGER);";
     
     rc = sqlite3_exec(db, sql_drawing, 0, 0, &err_msg);
     if (rc != SQLITE_OK) {
-        fprintf(stderr, "SQL error (create drawing_data): %s\n", err_msg);
+        fprintf(stderr, "SQL error (create drawings): %s\n", err_msg);
         sqlite3_free(err_msg);
     }
+    // Retention deletes the oldest rounds first
+    rc = sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS drawings_created ON drawings (created_at);", 0, 0, &err_msg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error (create drawings index): %s\n", err_msg);
+        sqlite3_free(err_msg);
+    }
+    sqlite3_stmt *legacy;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'drawing_data';",
+                           -1, &legacy, NULL) == SQLITE_OK) {
+        if (sqlite3_step(legacy) == SQLITE_ROW) {
+            printf("Legacy drawing_data table found, run with --migrate-drawings to pack it\n");
+        }
+        sqlite3_finalize(legacy);
+    }
     
-    // Check if words exist, if not add some
-    const char *count_words = "SELECT count(*) FROM words;";
-    sqlite3_stmt *stmt;
-    rc = sqlite3_prepare_v2(db, count_words, -1, &stmt, 0);
+    // Every statement used at run time is prepared once, here
+    if (db_prepare_statements(db) != 0 || db_readers_open(DB_PATH, &db_cfg) != 0) {
+        exit(1);
+    }
     
+    // Leaderboard from the stored totals
+    sqlite3_stmt *stmt = db_read_acquire(DB_STMT_ALL_STATS);
+    while (stmt && sqlite3_step(stmt) == SQLITE_ROW) {
+        PlayerStats stats;
+        snprintf(stats.username, sizeof(stats.username), "%s", (const char*)sqlite3_column_text(stmt, 0));
+        stats.games = (uint32_t)sqlite3_column_int(stmt, 1);
+        stats.wins = (uint32_t)sqlite3_column_int(stmt, 2);
+        stats.guesses = (uint32_t)sqlite3_column_int(stmt, 3);
+        stats.painter_rounds = (uint32_t)sqlite3_column_int(stmt, 4);
+        stats.ai_beaten = (uint32_t)sqlite3_column_int(stmt, 5);
+        leaderboard_put(&stats);
+    }
+    db_read_release(stmt);
+    printf("Leaderboard: %d players\n", leaderboard_size());
+    
+    // Check if words exist, if not add some
+    stmt = db_read_acquire(DB_STMT_COUNT_WORDS);
     int count = 0;
-    if (rc == SQLITE_OK) {
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            count = sqlite3_column_int(stmt, 0);
-        }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        count = sqlite3_column_int(stmt, 0);
     }
-    sqlite3_finalize(stmt);
+    db_read_release(stmt);
     
     if (count == 0) {
         printf("Populating words table...\n");
-        const char *initial_words[] = {
-            "apple", "banana", "watermelon", "car", "mouse", 
-            "computer", "ocean", "mountain", "sun", "moon",
-            "house", "tree", "dog", "cat", "bird"
+        const struct { const char *word, *category; int difficulty; } initial_words[] = {
+            {"apple", "fruit", 1}, {"banana", "fruit", 1}, {"watermelon", "fruit", 2},
+            {"car", "object", 1}, {"mouse", "animal", 2}, {"computer", "object", 2},
+            {"ocean", "nature", 2}, {"mountain", "nature", 1}, {"sun", "nature", 1},
+            {"moon", "nature", 1}, {"house", "object", 1}, {"tree", "nature", 1},
+            {"dog", "animal", 1}, {"cat", "animal", 1}, {"bird", "animal", 1}
         };
         int num_words = sizeof(initial_words) / sizeof(initial_words[0]);
         
+        sqlite3_exec(db, "BEGIN;", 0, 0, 0);
+        stmt = db_stmt_acquire(DB_STMT_INSERT_WORD);
         for (int i = 0; i < num_words; i++) {
-            char sql_insert[128];
-            sprintf(sql_insert, "INSERT INTO words (word) VALUES ('%s');", initial_words[i]);
-            sqlite3_exec(db, sql_insert, 0, 0, 0);
+            sqlite3_bind_text(stmt, 1, initial_words[i].word, -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, initial_words[i].category, -1, SQLITE_STATIC);
+            sqlite3_bind_int(stmt, 3, initial_words[i].difficulty);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
         }
+        db_stmt_release(DB_STMT_INSERT_WORD);
+        sqlite3_exec(db, "COMMIT;", 0, 0, 0);
     }
 }
 
-void get_random_word(char *buffer) {
-    const char *sql = "SELECT word FROM words ORDER BY RANDOM() LIMIT 1;";
-    sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
-    
-    if (rc == SQLITE_OK) {
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            const unsigned char *word = sqlite3_column_text(stmt, 0);
-            strcpy(buffer, (const char*)word);
-        } else {
-             // Fallback
-            strcpy(buffer, "apple");
+// Forward declarations
+void broadcast_message(BaseMessage* msg, int exclude_id, int room_id);
+
+// Word embeddings for the current word bank, built on first use
+EmbedIndex* word_index = NULL;
+int word_index_building = 0; // an encode is running outside the lock
+pthread_mutex_t word_index_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define WORD_BANK_POLL_INTERVAL 5 // seconds between words_version checks
+
+// Return a reference to the embedding index of the current candidate set.
+// If it is missing or stale, the first caller encodes the words through the
+// AI service without holding word_index_mutex; everyone else meanwhile gets
+// the old index (NULL before the first build) instead of waiting.
+EmbedIndex* acquire_word_index() {
+    WordBank* bank = word_bank_acquire();
+    if (!bank) return NULL;
+    pthread_mutex_lock(&word_index_mutex);
+    if ((!word_index || word_index->set_id != bank->set_id) && !word_index_building &&
+        ai_backend_ready() && ai_breaker_allow()) {
+        word_index_building = 1;
+        pthread_mutex_unlock(&word_index_mutex);
+
+        EmbedIndex* fresh = ai_backend()->encode_words(bank->set_id, bank->block, bank->len, bank->count);
+        ai_breaker_report(fresh != NULL);
+
+        pthread_mutex_lock(&word_index_mutex);
+        if (fresh) {
+            embed_index_release(word_index);
+            word_index = fresh;
         }
-    } else {
-        strcpy(buffer, "apple");
+        word_index_building = 0;
     }
-    sqlite3_finalize(stmt);
+    EmbedIndex* idx = word_index;
+    if (idx) embed_index_retain(idx);
+    pthread_mutex_unlock(&word_index_mutex);
+    word_bank_release(bank);
+    return idx;
 }
 
-// Forward declarations
-void broadcast_message(BaseMessage* msg, int exclude_id, int room_id);
+long long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// AI deadline (ai_clock_ms() time base) for the end of a game phase
+long long phase_deadline_ms(time_t phase_start, int phase_seconds) {
+    return ai_clock_ms() + (long long)(phase_start + phase_seconds - time(NULL)) * 1000;
+}
+
+// Encode a raster and rank the candidate words. Fills up to k words (best
+// first) with their probabilities in percent, plus the target's score.
+// Returns the number of guesses, or 0 if the AI is unavailable, missed the
+// deadline or the room's requests were cancelled.
+int run_ai_prediction(const Raster* raster, int room_id, long long deadline_ms, const char* target, int k,
+                      char words[][32], uint8_t* scores, int* target_score) {
+    EmbedIndex* idx = acquire_word_index();
+    if (!idx) return 0;
+    
+    metric_inc(METRIC_AI_REQUESTS);
+    
+    // Near-identical drawings reuse a recent embedding
+    RasterHash hash;
+    raster_hash(raster, &hash);
+    float* embedding = NULL;
+    int dim = 0;
+    if (ai_cache_lookup(&hash, idx->set_id, &embedding, &dim) != 0) {
+        if (ai_batch_encode_image(raster, room_id, deadline_ms, &embedding, &dim) == 0 && dim == idx->dim) {
+            ai_cache_store(&hash, idx->set_id, embedding, dim);
+        }
+    }
+    if (!embedding || dim != idx->dim) {
+        free(embedding);
+        embed_index_release(idx);
+        return 0;
+    }
+    
+    EmbedMatch matches[3];
+    float target_prob = 0.0f;
+    if (k > 3) k = 3;
+    int found = embed_index_rank(idx, embedding, k, matches, target ? embed_index_find(idx, target) : -1, &target_prob);
+    free(embedding);
+    
+    for (int i = 0; i < found; i++) {
+        strncpy(words[i], idx->word[matches[i].index], 31);
+        words[i][31] = '\0';
+        scores[i] = (uint8_t)(matches[i].prob * 100);
+    }
+    if (target_score) *target_score = (int)(target_prob * 100);
+    embed_index_release(idx);
+    return found;
+}
 
 void* ai_guess_thread(void* arg) {
     int room_id = *(int*)arg;
@@ -190,145 +441,144 @@ void* ai_guess_thread(void* arg) {
     
     printf("AI Thread: Starting inference for room %d\n", room_id);
     
-    pthread_mutex_lock(&rooms_mutex);
-    Room* room = &rooms[room_id];
-    
-    // Serialize data while locked
-    char* json_buf = malloc(256 * 1024);
-    if (!json_buf) {
-        pthread_mutex_unlock(&rooms_mutex);
+    Raster* raster = malloc(sizeof(Raster));
+    if (!raster) {
+        ai_player_offer(room_id, "", 0, 1);
         return NULL;
     }
     
-    // Get all words from database
-    char candidates_json[64 * 1024] = "["; // Large buffer for all words
-    int first = 1;
-    const char *sql = "SELECT word FROM words;";
-    sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) == SQLITE_OK) {
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            const char *word = (const char*)sqlite3_column_text(stmt, 0);
-            if (!first) {
-                strcat(candidates_json, ", ");
+    // Snapshot the live raster while locked
+    char target[32];
+    pthread_mutex_lock(&rooms_mutex);
+    Room* room = &rooms[room_id];
+    strcpy(target, room->game.current_word);
+    int game_id = room->game.current_game_id;
+    long long deadline = phase_deadline_ms(room->game.guess_start_time, GUESS_PHASE_SECONDS);
+    if (room->live_raster) {
+        memcpy(raster, room->live_raster, sizeof(Raster));
+    } else {
+        raster_clear(raster);
+        for (const StrokeChunk* chunk = room->strokes.head; chunk; chunk = chunk->next) {
+            for (int i = 0; i < chunk->count; i++) {
+                const StrokePoint* pt = &chunk->points[i];
+                raster_apply(raster, pt->x, pt->y, pt->action, pt->color_r, pt->color_g, pt->color_b);
             }
-            first = 0;
-            strcat(candidates_json, "\"");
-            strcat(candidates_json, word);
-            strcat(candidates_json, "\"");
         }
-        sqlite3_finalize(stmt);
-    }
-    strcat(candidates_json, "]");
-    
-    int offset = sprintf(json_buf, "{\"target\": \"%s\", \"candidates\": %s, \"drawing\": [", 
-                         room->game.current_word, candidates_json);
-    
-    for (int i = 0; i < room->history_count; i++) {
-        if (i > 0) offset += sprintf(json_buf + offset, ",");
-        offset += sprintf(json_buf + offset, "{\"x\":%d,\"y\":%d,\"action\":%d}", 
-                          room->drawing_history[i].x, 
-                          room->drawing_history[i].y, 
-                          room->drawing_history[i].action);
     }
-    sprintf(json_buf + offset, "]}");
-    
+    int num_points = room->strokes.count;
     pthread_mutex_unlock(&rooms_mutex);
     
-    // Connect to AI service
-    int ai_sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (ai_sock < 0) {
-        free(json_buf);
+    printf("AI Thread Room %d: Encoding raster of %d points...\n", room_id, num_points);
+    char predicted[1][32];
+    uint8_t prob;
+    int score = 0;
+    int found = run_ai_prediction(raster, room_id, deadline, target, 1, predicted, &prob, &score);
+    free(raster);
+    if (found == 0) {
+        printf("AI Thread Room %d: AI prediction unavailable\n", room_id);
+        ai_player_offer(room_id, "", 0, 1); // the AI player passes instead of holding up the round
         return NULL;
     }
+    int is_correct = strcmp(predicted[0], target) == 0;
     
-    struct sockaddr_in ai_addr;
-    ai_addr.sin_family = AF_INET;
-    ai_addr.sin_port = htons(5000);
-    ai_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-    
-    if (connect(ai_sock, (struct sockaddr*)&ai_addr, sizeof(ai_addr)) < 0) {
-        printf("AI Thread Room %d: Failed to connect to AI service on port 5000. Is ai_service.py running?\n", room_id);
-        free(json_buf);
-        close(ai_sock);
+    // Store result instead of broadcasting immediately, unless the round
+    // is already over
+    pthread_mutex_lock(&rooms_mutex);
+    room = &rooms[room_id];
+    if (room->game.current_game_id != game_id || room->game.state != GAME_GUESSING) {
         pthread_mutex_unlock(&rooms_mutex);
+        printf("AI Thread Room %d: Round ended before the prediction, dropped\n", room_id);
         return NULL;
     }
+    strcpy(room->ai_predicted_word, predicted[0]);
+    room->ai_score = score;
+    room->ai_is_correct = is_correct;
+    room->ai_result_ready = 1;
+    pthread_mutex_unlock(&rooms_mutex);
     
-    printf("AI Thread Room %d: Connected to AI service, sending data...\n", room_id);
-    
-    // Send data
-    uint32_t len = htonl(strlen(json_buf));
-    send(ai_sock, &len, 4, 0);
-    send(ai_sock, json_buf, strlen(json_buf), 0);
-    free(json_buf);
-    
-    // Receive response
-    uint32_t resp_len;
-    if (recv(ai_sock, &resp_len, 4, 0) == 4) {
-        resp_len = ntohl(resp_len);
-        printf("AI Thread Room %d: Receiving response, length: %u\n", room_id, resp_len);
-        char* resp_buf = malloc(resp_len + 1);
-        if (!resp_buf) {
-            printf("AI Thread Room %d: Failed to allocate response buffer\n", room_id);
-            close(ai_sock);
-            return NULL;
-        }
-        int received = 0;
-        while (received < resp_len) {
-            int r = recv(ai_sock, resp_buf + received, resp_len - received, 0);
-            if (r <= 0) {
-                printf("AI Thread Room %d: Error receiving response data\n", room_id);
-                free(resp_buf);
-                close(ai_sock);
-                return NULL;
-            }
-            received += r;
-        }
-        resp_buf[received] = '\0';
-        
-        printf("AI Thread Room %d: Received response: %s\n", room_id, resp_buf);
-        
-        char predicted[32] = "Unknown";
-        int is_correct = 0;
-        int score = 0;
-        
-        char* p = strstr(resp_buf, "\"predicted_word\": \"");
-        if (p) {
-            p += 19;
-            char* end = strchr(p, '\"');
-            if (end) {
-                *end = '\0';
-                strncpy(predicted, p, 31);
-                *end = '\"'; // Restore
-            }
-        }
-        
-        p = strstr(resp_buf, "\"is_correct\": ");
-        if (p) is_correct = atoi(p + 14);
-        
-        p = strstr(resp_buf, "\"score\": ");
-        if (p) score = atoi(p + 9);
-        
-        // Store result instead of broadcasting immediately
-        pthread_mutex_lock(&rooms_mutex);
-        Room* room = &rooms[room_id];
-        strcpy(room->ai_predicted_word, predicted);
-        room->ai_score = score;
-        room->ai_is_correct = is_correct;
-        room->ai_result_ready = 1;
-        pthread_mutex_unlock(&rooms_mutex);
-        
-        printf("AI Result Room %d: Predicted=%s, Correct=%d, Score=%d (stored, will broadcast after all guesses)\n", room_id, predicted, is_correct, score);
-        
-        free(resp_buf);
-    } else {
-        printf("AI Thread Room %d: Failed to receive response length from AI service\n", room_id);
+    printf("AI Result Room %d: Predicted=%s, Correct=%d, Score=%d (stored, will broadcast after all guesses)\n", room_id, predicted[0], is_correct, score);
+    ai_player_offer(room_id, predicted[0], prob, 1);
+    
+    return NULL;
+}
+
+typedef struct {
+    int room_id;
+    int game_id;
+    long long deadline_ms; // end of the painting phase
+    Raster raster;
+} LiveGuessJob;
+
+// Live prediction while painting: rank the snapshot and show the current
+// top 3 to everyone but the painter
+void* ai_live_thread(void* arg) {
+    LiveGuessJob* job = (LiveGuessJob*)arg;
+    
+    AiLiveGuessMessage live_msg;
+    memset(&live_msg, 0, sizeof(live_msg));
+    live_msg.base.type = MSG_AI_LIVE_GUESS;
+    live_msg.base.client_id = 0;
+    live_msg.base.data_len = sizeof(AiLiveGuessMessage) - sizeof(BaseMessage);
+    long long started = now_ms();
+    live_msg.num_guesses = (uint8_t)run_ai_prediction(&job->raster, job->room_id, job->deadline_ms, NULL, 3, live_msg.words, live_msg.scores, NULL);
+    
+    pthread_mutex_lock(&rooms_mutex);
+    Room* room = &rooms[job->room_id];
+    int current = room->game.current_game_id == job->game_id;
+    int publish = current && room->game.state == GAME_PAINTING && live_msg.num_guesses > 0;
+    int painter_id = room->game.painter_id;
+    if (current) {
+        room->live_inflight--;
+        room->ai_spent_ms += now_ms() - started;
     }
+    live_inflight_total--;
+    pthread_mutex_unlock(&rooms_mutex);
     
-    close(ai_sock);
+    if (publish) {
+        broadcast_message((BaseMessage*)&live_msg, painter_id, job->room_id);
+        ai_player_offer(job->room_id, live_msg.words[0], live_msg.scores[0], 0);
+    }
+    free(job);
     return NULL;
 }
 
+// Called with rooms_mutex held after new points: submit a live prediction
+// every AI_LIVE_EVERY_POINTS points or AI_LIVE_INTERVAL_MS, whichever
+// comes first, with at most AI_LIVE_MAX_INFLIGHT per room and
+// AI_LIVE_MAX_TOTAL overall, until the room's budget for the round is spent
+void maybe_submit_live_guess(int room_id) {
+    Room* room = &rooms[room_id];
+    if (room->game.state != GAME_PAINTING || !room->live_raster || room->live_points == 0) return;
+    if (room->live_inflight >= AI_LIVE_MAX_INFLIGHT) return;
+    
+    long long now = now_ms();
+    if (room->live_points < AI_LIVE_EVERY_POINTS && now - room->live_last_ms < AI_LIVE_INTERVAL_MS) return;
+    if (room->ai_spent_ms >= AI_ROOM_BUDGET_MS || live_inflight_total >= AI_LIVE_MAX_TOTAL) {
+        // Shed this one; the points stay pending for the next attempt
+        metric_inc(METRIC_AI_LIVE_SKIPPED);
+        room->live_last_ms = now;
+        return;
+    }
+    
+    LiveGuessJob* job = malloc(sizeof(LiveGuessJob));
+    if (!job) return;
+    job->room_id = room_id;
+    job->game_id = room->game.current_game_id;
+    job->deadline_ms = phase_deadline_ms(room->game.paint_start_time, PAINT_PHASE_SECONDS);
+    memcpy(&job->raster, room->live_raster, sizeof(Raster));
+    
+    pthread_t live_thread;
+    if (pthread_create(&live_thread, NULL, ai_live_thread, job) != 0) {
+        free(job);
+        return;
+    }
+    pthread_detach(live_thread);
+    room->live_inflight++;
+    live_inflight_total++;
+    room->live_points = 0;
+    room->live_last_ms = now;
+}
+
 void* handle_tcp_client(void* arg);
 void* handle_udp_server(void* arg);
 void broadcast_message(BaseMessage* msg, int exclude_id, int room_id);
@@ -354,16 +604,21 @@ void init_game(GameInfo* game_info) {
     memset(game_info->current_word, 0, sizeof(game_info->current_word)); // Clear current word
 }
 
-// Add client to client list
-int add_client(int socket_fd) {
+// Add client to client list; AI players get their own slots, so they never
+// take one from a human
+int add_client(int socket_fd, int is_ai) {
     pthread_mutex_lock(&clients_mutex);
     
     // Find an empty client slot
-    for (int i = 0; i < MAX_CLIENTS; i++) {
+    for (int i = is_ai ? MAX_CLIENTS : 0; i < (is_ai ? MAX_CONNECTIONS : MAX_CLIENTS); i++) {
         if (clients[i].socket_fd == -1) {
             //init client info
             clients[i].socket_fd = socket_fd;
             clients[i].id = i;
+            pthread_mutex_lock(&senders[i].mutex);
+            senders[i].fd = socket_fd;
+            senders[i].conn++;
+            pthread_mutex_unlock(&senders[i].mutex);
             clients[i].ready = 0;
             clients[i].is_painter = 0;
             clients[i].has_guessed = 0;
@@ -372,6 +627,7 @@ int add_client(int socket_fd) {
             memset(clients[i].guess, 0, sizeof(clients[i].guess));
             clients[i].has_udp_addr = 0;
             clients[i].room_id = -1; // Initialize room_id
+            clients[i].is_ai = is_ai;
             memset(&clients[i].udp_addr, 0, sizeof(clients[i].udp_addr));
             
             // game.total_clients++; // Removed global game update
@@ -386,11 +642,33 @@ int add_client(int socket_fd) {
     return -1;
 }
 
+// Register one end of an AI player's socketpair as a client, served by the
+// same handler thread as a network client
+int attach_ai_client(int fd) {
+    int client_id = add_client(fd, 1);
+    if (client_id == -1) return -1;
+    pthread_mutex_lock(&clients_mutex);
+    strcpy(clients[client_id].nickname, AI_PLAYER_NICKNAME);
+    pthread_mutex_unlock(&clients_mutex);
+    
+    pthread_t client_thread;
+    pthread_create(&client_thread, NULL, handle_tcp_client, &clients[client_id].id);
+    pthread_detach(client_thread);
+    return client_id;
+}
+
 //call when a client disconnects
 void remove_client(int client_id) {
+    int ai_leaves = -1; // room to take the AI player out of, after the locks
     pthread_mutex_lock(&clients_mutex);
     
-    if (client_id >= 0 && client_id < MAX_CLIENTS && clients[client_id].socket_fd != -1) {
+    if (client_id >= 0 && client_id < MAX_CONNECTIONS && clients[client_id].socket_fd != -1) {
+        replay_cancel(client_id);
+        // Wake a send stuck on this socket, then wait for it before closing
+        shutdown(clients[client_id].socket_fd, SHUT_RDWR);
+        pthread_mutex_lock(&senders[client_id].mutex);
+        senders[client_id].fd = -1;
+        pthread_mutex_unlock(&senders[client_id].mutex);
         close(clients[client_id].socket_fd);
         clients[client_id].socket_fd = -1;
         // game.total_clients--; // Removed global game update
@@ -403,13 +681,16 @@ void remove_client(int client_id) {
                 rooms[room_id].game.ready_count--;
         }
             // Remove from room clients list
-            for (int i = 0; i < MAX_CLIENTS; i++) {
+            for (int i = 0; i < ROOM_SLOTS; i++) {
                 if (rooms[room_id].clients[i].id == client_id) {
                     rooms[room_id].clients[i].socket_fd = -1;
                     rooms[room_id].client_count--;
                     if (rooms[room_id].client_count == 0) {
                          memset(rooms[room_id].name, 0, sizeof(rooms[room_id].name));
                          init_game(&rooms[room_id].game);
+                         ai_batch_cancel(room_id);
+                    } else if (room_human_count(&rooms[room_id]) == 0) {
+                         ai_leaves = room_id; // the room empties once it is gone
                     }
                     break;
                 }
@@ -422,6 +703,7 @@ void remove_client(int client_id) {
     }
     
     pthread_mutex_unlock(&clients_mutex);
+    if (ai_leaves != -1) ai_player_leave(ai_leaves);
 }
 
 //Broadcast to guesser in a specific room
@@ -429,7 +711,7 @@ void broadcast_message(BaseMessage* msg, int exclude_id, int room_id) {
     if (room_id < 0 || room_id >= MAX_ROOMS) return;
 
     pthread_mutex_lock(&rooms_mutex);
-    for (int i = 0; i < MAX_CLIENTS; i++) {
+    for (int i = 0; i < ROOM_SLOTS; i++) {
         int client_idx = rooms[room_id].clients[i].id;
         if (rooms[room_id].clients[i].socket_fd != -1 && client_idx != exclude_id) {
             // Use the global clients array to get the socket_fd because room clients might be copies or just IDs
@@ -437,12 +719,98 @@ void broadcast_message(BaseMessage* msg, int exclude_id, int room_id) {
             // or just use the socket_fd stored in room.
             // Let's use the socket_fd stored in room->clients
              if (rooms[room_id].clients[i].socket_fd != -1)
-                send(rooms[room_id].clients[i].socket_fd, msg, sizeof(BaseMessage) + msg->data_len, 0);
+                send_to_client(client_idx, msg, sizeof(BaseMessage) + msg->data_len);
         }
     }
     pthread_mutex_unlock(&rooms_mutex);
 }
 
+// Write the rest of a frame, retrying short sends
+static int send_all(int fd, const char* p, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Write a whole frame to a client; -1 if it is gone
+int send_to_client(int client_id, const void* buf, size_t len) {
+    if (client_id < 0 || client_id >= MAX_CONNECTIONS) return -1;
+    ClientSender* s = &senders[client_id];
+    pthread_mutex_lock(&s->mutex);
+    int rc = s->fd == -1 ? -1 : send_all(s->fd, buf, len);
+    pthread_mutex_unlock(&s->mutex);
+    return rc;
+}
+
+// Replay's send path: never waits for another sender or a full socket.
+// A frame the socket took only part of is finished within a short poll, or
+// the connection is shut down, since nothing else may go out mid-frame.
+static int send_to_client_nowait(int client_id, unsigned conn, const void* buf, size_t len) {
+    if (client_id < 0 || client_id >= MAX_CONNECTIONS) return -1;
+    ClientSender* s = &senders[client_id];
+    if (pthread_mutex_trylock(&s->mutex) != 0) return 0;
+    int rc = 1;
+    if (s->fd == -1 || s->conn != conn) {
+        rc = -1;
+    } else {
+        ssize_t n = send(s->fd, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            rc = errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        } else {
+            const char* p = (const char*)buf + n;
+            len -= (size_t)n;
+            while (len > 0) {
+                struct pollfd pfd = { s->fd, POLLOUT, 0 };
+                if (poll(&pfd, 1, SEND_PARTIAL_MS) <= 0 ||
+                    (n = send(s->fd, p, len, MSG_DONTWAIT | MSG_NOSIGNAL)) <= 0) {
+                    shutdown(s->fd, SHUT_RDWR); // the handler sees it and removes the client
+                    rc = -1;
+                    break;
+                }
+                p += n;
+                len -= (size_t)n;
+            }
+        }
+    }
+    pthread_mutex_unlock(&s->mutex);
+    return rc;
+}
+
+// Fill page with up to page_size of username's rows older than before;
+// one index range scan whatever the page depth. Returns the row count.
+static int history_page(const char* username, int before, int page_size, HistoryPageMessage* page) {
+    sqlite3_stmt *stmt = db_read_acquire(DB_STMT_SELECT_HISTORY);
+    int count = 0;
+    if (stmt) {
+        sqlite3_bind_text(stmt, 1, username, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, before);
+        sqlite3_bind_int(stmt, 3, page_size + 1); // one extra row tells whether more exist
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            if (count == page_size) {
+                page->more = 1;
+                break;
+            }
+            HistoryRow* row = &page->rows[count++];
+            row->record_id = sqlite3_column_int(stmt, 0);
+            row->game_id = sqlite3_column_int(stmt, 1);
+            const char* word = (const char*)sqlite3_column_text(stmt, 2);
+            const char* guess = (const char*)sqlite3_column_text(stmt, 3);
+            const char* game_time = (const char*)sqlite3_column_text(stmt, 4);
+            snprintf(row->word, sizeof(row->word), "%s", word ? word : "");
+            snprintf(row->user_guess, sizeof(row->user_guess), "%s", guess ? guess : "");
+            snprintf(row->game_time, sizeof(row->game_time), "%s", game_time ? game_time : "");
+        }
+    }
+    db_read_release(stmt);
+    page->count = (uint8_t)count;
+    page->next_before = count > 0 ? page->rows[count - 1].record_id : 0;
+    return count;
+}
+
 void start_game(int room_id) {
     pthread_mutex_lock(&rooms_mutex);
     Room* room = &rooms[room_id];
@@ -457,13 +825,18 @@ void start_game(int room_id) {
 
     //Random seed for selecting painter
     srand((unsigned int)time(NULL));
-    int start_index = rand() % room->client_count;
+    int humans = room_human_count(room); // the AI player never paints
+    if (humans == 0) {
+        pthread_mutex_unlock(&rooms_mutex);
+        return;
+    }
+    int start_index = rand() % humans;
     int painter_idx = -1;
     
     // Find valid painter in this room
     int count = 0;
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (room->clients[i].socket_fd != -1) {
+    for (int i = 0; i < ROOM_SLOTS; i++) {
+        if (room->clients[i].socket_fd != -1 && !room->clients[i].is_ai) {
             if (count == start_index) {
                 painter_idx = i; // Index in room->clients array
                 game->painter_id = room->clients[i].id; // Global client ID
@@ -481,21 +854,31 @@ void start_game(int room_id) {
         return;
     }
 
-    // Random seed for select word
-    get_random_word(game->current_word);
+    // Next word from the room's shuffle bag (in memory, no repeats until
+    // the bag is empty)
+    if (word_bag_next(&room->word_bag, game->current_word, sizeof(game->current_word)) != 0) {
+        strcpy(game->current_word, "apple");
+    }
 
     game->state = GAME_PAINTING;
     game->paint_start_time = time(NULL);
     game->current_game_id = (int)time(NULL) + rand(); // Generate unique game ID for this session
     
     // Initialize drawing history for AI
-    room->history_count = 0;
+    stroke_buffer_release(&room->strokes);
+    stroke_buffer_init(&room->strokes, now_ms());
+    if (!room->live_raster) room->live_raster = malloc(sizeof(Raster));
+    if (room->live_raster) raster_clear(room->live_raster);
+    room->live_points = 0;
+    room->live_last_ms = now_ms();
+    room->live_inflight = 0;
+    room->ai_spent_ms = 0;
     
     // Reset AI result for new game
     room->ai_result_ready = 0;
     memset(room->ai_predicted_word, 0, sizeof(room->ai_predicted_word));
 
-    for (int i = 0; i < MAX_CLIENTS; i++) {
+    for (int i = 0; i < ROOM_SLOTS; i++) {
         if (room->clients[i].socket_fd != -1) {
             GameStartMessage start_msg;
             start_msg.base.type = MSG_GAME_START;
@@ -504,7 +887,7 @@ void start_game(int room_id) {
             start_msg.painter_id = (uint8_t)game->painter_id;
             strcpy(start_msg.word, game->current_word);
             start_msg.paint_time = 60;
-            send(room->clients[i].socket_fd, &start_msg, sizeof(start_msg), 0);
+            send_to_client(room->clients[i].id, &start_msg, sizeof(start_msg));
         }
     }
 
@@ -513,6 +896,70 @@ void start_game(int room_id) {
     pthread_mutex_unlock(&rooms_mutex);
 }
 
+// One finished round for the DB writer: history rows and stat deltas for
+// the humans in the room (not the AI player) and the stroke buffer to pack
+typedef struct {
+    DbWrite write; // first, so the job is freed through it
+    DrawingInfo info;
+    char game_time[32];
+    int num_rows;
+    struct {
+        char username[32];
+        char guess[64];
+    } rows[MAX_CLIENTS];
+    int num_deltas;
+    PlayerStats deltas[MAX_CLIENTS];
+    StrokeBuffer strokes;
+} RoundRecord;
+
+static int round_record_apply(DbWrite* w) {
+    RoundRecord* rec = (RoundRecord*)w;
+    int failed = 0;
+    sqlite3_stmt *stmt = db_stmt_acquire(DB_STMT_INSERT_HISTORY);
+    for (int i = 0; stmt && !failed && i < rec->num_rows; i++) {
+        sqlite3_bind_int(stmt, 1, rec->info.game_id);
+        sqlite3_bind_text(stmt, 2, rec->info.word, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, rec->rows[i].username, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 4, rec->rows[i].guess, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 5, rec->game_time, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) != SQLITE_DONE) failed = 1;
+        sqlite3_reset(stmt);
+    }
+    if (!stmt) failed = 1;
+    db_stmt_release(DB_STMT_INSERT_HISTORY);
+
+    stmt = db_stmt_acquire(DB_STMT_ADD_STATS);
+    for (int i = 0; stmt && !failed && i < rec->num_deltas; i++) {
+        const PlayerStats* d = &rec->deltas[i];
+        sqlite3_bind_text(stmt, 1, d->username, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, d->wins);
+        sqlite3_bind_int(stmt, 3, d->guesses);
+        sqlite3_bind_int(stmt, 4, d->painter_rounds);
+        sqlite3_bind_int(stmt, 5, d->ai_beaten);
+        if (sqlite3_step(stmt) != SQLITE_DONE) failed = 1;
+        sqlite3_reset(stmt);
+    }
+    if (!stmt) failed = 1;
+    db_stmt_release(DB_STMT_ADD_STATS);
+
+    // The round's drawing, packed into one row; losing it keeps the rest
+    if (!failed && rec->strokes.count > 0 && drawing_save(&rec->info, &rec->strokes) != 0) {
+        fprintf(stderr, "Room %d: failed to save drawing of game %d\n", rec->info.room_id, rec->info.game_id);
+    }
+    return failed ? -1 : 0;
+}
+
+static void round_record_done(DbWrite* w, int ok) {
+    RoundRecord* rec = (RoundRecord*)w;
+    if (ok) {
+        for (int i = 0; i < rec->num_deltas; i++) leaderboard_add(&rec->deltas[i]);
+    } else {
+        fprintf(stderr, "Room %d: game %d was not saved\n", rec->info.room_id, rec->info.game_id);
+    }
+    stroke_buffer_release(&rec->strokes);
+    free(rec);
+}
+
 void end_game(int room_id) {
     pthread_mutex_lock(&rooms_mutex);
     Room* room = &rooms[room_id];
@@ -524,6 +971,7 @@ void end_game(int room_id) {
     }
     
     game->state = GAME_FINISHED;
+    ai_batch_cancel(room_id); // nobody will see a late prediction
     
     GameEndMessage end_msg;
     end_msg.base.type = MSG_GAME_END;
@@ -534,7 +982,7 @@ void end_game(int room_id) {
     end_msg.guess_count = 0;
     
     //find winner in room
-    for (int i = 0; i < MAX_CLIENTS; i++) {
+    for (int i = 0; i < ROOM_SLOTS; i++) {
         if (room->clients[i].socket_fd != -1 && room->clients[i].has_guessed) {
             end_msg.guess_count++;
 
@@ -554,6 +1002,8 @@ void end_game(int room_id) {
         printf("Room %d Game over! Answer: %s, No one guessed it\n", room_id, game->current_word);
     }
     
+    int ai_wrong = room->ai_result_ready && !room->ai_is_correct;
+    
     // Broadcast AI result after all clients have submitted
     if (room->ai_result_ready) {
         AiGuessResultMessage ai_msg;
@@ -574,36 +1024,40 @@ void end_game(int room_id) {
         room->ai_result_ready = 0;
     }
     
-    // Save history to DB
-    int game_id = game->current_game_id; // Use the stored game_id
-    char time_str[32];
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    strftime(time_str, sizeof(time_str)-1, "%Y-%m-%d %H:%M:%S", t);
-    
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (room->clients[i].socket_fd != -1) {
-            // Save for everyone
-            const char *sql = "INSERT INTO history (game_id, word, username, user_guess, game_time) VALUES (?, ?, ?, ?, ?);";
-            sqlite3_stmt *stmt;
-            if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) == SQLITE_OK) {
-                sqlite3_bind_int(stmt, 1, game_id);
-                sqlite3_bind_text(stmt, 2, game->current_word, -1, SQLITE_STATIC);
-                sqlite3_bind_text(stmt, 3, room->clients[i].nickname, -1, SQLITE_STATIC);
-                
-                if (room->clients[i].id == game->painter_id) {
-                     sqlite3_bind_text(stmt, 4, "(Painter)", -1, SQLITE_STATIC);
-                } else if (room->clients[i].has_guessed) {
-                     sqlite3_bind_text(stmt, 4, room->clients[i].guess, -1, SQLITE_STATIC);
-                } else {
-                     sqlite3_bind_text(stmt, 4, "(No Guess)", -1, SQLITE_STATIC);
-                }
-                
-                sqlite3_bind_text(stmt, 5, time_str, -1, SQLITE_STATIC);
-                
-                sqlite3_step(stmt);
-                sqlite3_finalize(stmt);
-            }
+    // Hand the round to the DB writer; nothing here waits for the disk
+    RoundRecord* rec = calloc(1, sizeof(RoundRecord));
+    if (rec) {
+        rec->write.apply = round_record_apply;
+        rec->write.done = round_record_done;
+        rec->info.game_id = game->current_game_id;
+        rec->info.room_id = room_id;
+        snprintf(rec->info.word, sizeof(rec->info.word), "%s", game->current_word);
+        time_t now = time(NULL);
+        strftime(rec->game_time, sizeof(rec->game_time), "%Y-%m-%d %H:%M:%S", localtime(&now));
+
+        for (int i = 0; i < ROOM_SLOTS; i++) {
+            ClientInfo* c = &room->clients[i];
+            if (c->socket_fd == -1 || c->is_ai) continue;
+            // History for every human
+            const char* guess = c->id == game->painter_id ? "(Painter)" : c->has_guessed && c->guess[0] ? c->guess : "(No Guess)";
+            snprintf(rec->rows[rec->num_rows].username, sizeof(rec->rows[0].username), "%s", c->nickname);
+            snprintf(rec->rows[rec->num_rows].guess, sizeof(rec->rows[0].guess), "%s", guess);
+            rec->num_rows++;
+
+            // Per-player totals
+            if (c->nickname[0] == '\0') continue;
+            PlayerStats* d = &rec->deltas[rec->num_deltas++];
+            snprintf(d->username, sizeof(d->username), "%s", c->nickname);
+            d->games = 1;
+            d->painter_rounds = c->id == game->painter_id;
+            d->guesses = c->has_guessed && !d->painter_rounds;
+            d->wins = d->guesses && strcmp(c->guess, game->current_word) == 0;
+            d->ai_beaten = d->wins && ai_wrong;
+        }
+
+        if (room->strokes.count > 0) {
+            rec->info.points = room->strokes.count;
+            rec->info.duration_ms = room->strokes.tail->points[room->strokes.tail->count - 1].t_ms;
         }
     }
 
@@ -611,9 +1065,18 @@ void end_game(int room_id) {
     game->painter_id = -1;
     game->ready_count = 0;
     memset(game->current_word, 0, sizeof(game->current_word));
+    free(room->live_raster);
+    room->live_raster = NULL;
+    printf("Room %d drawing: %d points in %d chunks (%zu bytes)\n", room_id,
+           room->strokes.count, room->strokes.chunks, stroke_buffer_bytes(&room->strokes));
+    if (rec) {
+        rec->strokes = room->strokes; // the writer packs it, then releases it
+        stroke_buffer_init(&room->strokes, 0);
+    }
+    stroke_buffer_release(&room->strokes);
     
     //reset room client states
-    for (int i = 0; i < MAX_CLIENTS; i++) {
+    for (int i = 0; i < ROOM_SLOTS; i++) {
         if (room->clients[i].socket_fd != -1) {
             room->clients[i].ready = 0;        
             room->clients[i].has_guessed = 0;  
@@ -629,6 +1092,7 @@ void end_game(int room_id) {
     }
     
     pthread_mutex_unlock(&rooms_mutex);
+    if (rec) db_write(&rec->write);
 }
 
 void* handle_tcp_client(void* arg) {
@@ -658,7 +1122,7 @@ void* handle_tcp_client(void* arg) {
                 if (room_id != -1) {
                     pthread_mutex_lock(&rooms_mutex);
                     // Find client in room
-                    for (int i = 0; i < MAX_CLIENTS; i++) {
+                    for (int i = 0; i < ROOM_SLOTS; i++) {
                         if (rooms[room_id].clients[i].id == client_id) {
                             if (!rooms[room_id].clients[i].ready) {
                                 rooms[room_id].clients[i].ready = 1;
@@ -729,7 +1193,7 @@ void* handle_tcp_client(void* arg) {
                 if (room_id != -1) {
                     pthread_mutex_lock(&rooms_mutex);
                     // Update room client
-                    for (int i = 0; i < MAX_CLIENTS; i++) {
+                    for (int i = 0; i < ROOM_SLOTS; i++) {
                         if (rooms[room_id].clients[i].id == client_id) {
                             strcpy(rooms[room_id].clients[i].guess, guess_msg->guess);
                             rooms[room_id].clients[i].has_guessed = 1;
@@ -747,7 +1211,7 @@ void* handle_tcp_client(void* arg) {
                 }
                 
                 int all_guessed = 1;
-                for (int i = 0; i < MAX_CLIENTS; i++) {
+                for (int i = 0; i < ROOM_SLOTS; i++) {
                         if (rooms[room_id].clients[i].socket_fd != -1 && !rooms[room_id].clients[i].is_painter && !rooms[room_id].clients[i].has_guessed) {
                         all_guessed = 0;
                         break;
@@ -767,34 +1231,103 @@ void* handle_tcp_client(void* arg) {
                 return NULL;
             }
             
+            case MSG_LEADERBOARD_REQ: {
+                LeaderboardRequestMessage* req = (LeaderboardRequestMessage*)msg;
+                int count = 10;
+                char username[32];
+                snprintf(username, sizeof(username), "%s", clients[client_id].nickname);
+                if (req->base.data_len >= offsetof(LeaderboardRequestMessage, username) + sizeof(req->username) - sizeof(BaseMessage)) {
+                    if (req->count > 0) count = req->count < LEADERBOARD_MAX_ROWS ? req->count : LEADERBOARD_MAX_ROWS;
+                    if (req->username[0]) snprintf(username, sizeof(username), "%.31s", req->username);
+                }
+                
+                LeaderboardMessage lb_msg;
+                memset(&lb_msg, 0, sizeof(lb_msg));
+                lb_msg.base.type = MSG_LEADERBOARD;
+                lb_msg.base.client_id = 0;
+                lb_msg.total_players = (uint32_t)leaderboard_size();
+                
+                PlayerStats top[LEADERBOARD_MAX_ROWS];
+                PlayerStats me;
+                int n = leaderboard_top(1, count, top);
+                int rank = leaderboard_rank(username, &me);
+                if (rank == 0) {
+                    memset(&me, 0, sizeof(me));
+                    snprintf(me.username, sizeof(me.username), "%s", username);
+                }
+                for (int i = 0; i <= n; i++) {
+                    const PlayerStats* s = i < n ? &top[i] : &me;
+                    LeaderboardEntry* e = i < n ? &lb_msg.entries[i] : &lb_msg.player;
+                    memcpy(e->username, s->username, sizeof(e->username));
+                    e->rank = i < n ? (uint32_t)(i + 1) : (uint32_t)rank;
+                    e->games = s->games;
+                    e->wins = s->wins;
+                    e->guesses = s->guesses;
+                    e->painter_rounds = s->painter_rounds;
+                    e->ai_beaten = s->ai_beaten;
+                }
+                lb_msg.count = (uint8_t)n;
+                lb_msg.base.data_len = offsetof(LeaderboardMessage, entries[n]) - sizeof(BaseMessage);
+                send_to_client(client_id, &lb_msg, sizeof(BaseMessage) + lb_msg.base.data_len);
+                break;
+            }
+            
+            case MSG_REPLAY_REQ: {
+                ReplayRequestMessage* req = (ReplayRequestMessage*)msg;
+                if (req->base.data_len < offsetof(ReplayRequestMessage, speed) + 1 - sizeof(BaseMessage)) break;
+                printf("Client %d requested replay of game %d at speed %d\n", client_id, req->game_id, req->speed);
+                if (replay_request(client_id, senders[client_id].conn, req->game_id, req->speed) != 0) {
+                    ReplayEndMessage busy;
+                    memset(&busy, 0, sizeof(busy));
+                    busy.base.type = MSG_REPLAY_END;
+                    busy.base.client_id = 0;
+                    busy.base.data_len = sizeof(ReplayEndMessage) - sizeof(BaseMessage);
+                    busy.game_id = req->game_id;
+                    busy.status = REPLAY_BUSY;
+                    send_to_client(client_id, &busy, sizeof(busy));
+                }
+                break;
+            }
+            
             case MSG_HISTORY_REQ: {
-                printf("Client %d requested history\n", client_id);
-                const char *sql = "SELECT game_id, word, user_guess, game_time FROM history WHERE username = ? ORDER BY record_id DESC LIMIT 50;";
-                sqlite3_stmt *stmt;
-                if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) == SQLITE_OK) {
-                    sqlite3_bind_text(stmt, 1, clients[client_id].nickname, -1, SQLITE_STATIC);
-                    
-                    while (sqlite3_step(stmt) == SQLITE_ROW) {
-                        HistoryDataMessage h_msg;
-                        h_msg.base.type = MSG_HISTORY_DATA;
-                        h_msg.base.client_id = 0;
-                        h_msg.base.data_len = sizeof(HistoryDataMessage) - sizeof(BaseMessage);
-                        
-                        h_msg.game_id = sqlite3_column_int(stmt, 0);
-                        strcpy(h_msg.word, (const char*)sqlite3_column_text(stmt, 1));
-                        strcpy(h_msg.user_guess, (const char*)sqlite3_column_text(stmt, 2));
-                        strcpy(h_msg.game_time, (const char*)sqlite3_column_text(stmt, 3));
-                        
-                        send(clients[client_id].socket_fd, &h_msg, sizeof(BaseMessage) + h_msg.base.data_len, 0);
+                HistoryRequestMessage* req = (HistoryRequestMessage*)msg;
+                int paged = req->base.data_len >= offsetof(HistoryRequestMessage, page_size) + 1 - sizeof(BaseMessage);
+                int before = paged && req->before_record_id > 0 ? req->before_record_id : INT32_MAX;
+                int page_size = paged && req->page_size > 0 && req->page_size < HISTORY_PAGE_ROWS
+                                    ? req->page_size : HISTORY_PAGE_ROWS;
+                printf("Client %d requested history before %d\n", client_id, before);
+                
+                HistoryPageMessage page;
+                memset(&page, 0, offsetof(HistoryPageMessage, rows));
+                int fetched = history_page(clients[client_id].nickname, before, page_size, &page);
+                
+                if (paged) {
+                    page.base.type = MSG_HISTORY_PAGE;
+                    page.base.client_id = 0;
+                    page.base.data_len = offsetof(HistoryPageMessage, rows[page.count]) - sizeof(BaseMessage);
+                    send_to_client(client_id, &page, sizeof(BaseMessage) + page.base.data_len);
+                } else {
+                    // Older clients: one message per row, still written with a single send
+                    char legacy[HISTORY_PAGE_ROWS * sizeof(HistoryDataMessage) + sizeof(BaseMessage)];
+                    size_t len = 0;
+                    for (int i = 0; i < fetched; i++) {
+                        HistoryDataMessage* h_msg = (HistoryDataMessage*)(legacy + len);
+                        h_msg->base.type = MSG_HISTORY_DATA;
+                        h_msg->base.client_id = 0;
+                        h_msg->base.data_len = sizeof(HistoryDataMessage) - sizeof(BaseMessage);
+                        h_msg->game_id = page.rows[i].game_id;
+                        memcpy(h_msg->word, page.rows[i].word, sizeof(h_msg->word));
+                        memcpy(h_msg->user_guess, page.rows[i].user_guess, sizeof(h_msg->user_guess));
+                        memcpy(h_msg->game_time, page.rows[i].game_time, sizeof(h_msg->game_time));
+                        len += sizeof(HistoryDataMessage);
                     }
-                    sqlite3_finalize(stmt);
+                    BaseMessage* end_msg = (BaseMessage*)(legacy + len);
+                    end_msg->type = MSG_HISTORY_END;
+                    end_msg->client_id = 0;
+                    end_msg->data_len = 0;
+                    len += sizeof(BaseMessage);
+                    send_to_client(client_id, legacy, len);
                 }
-                
-                BaseMessage end_msg;
-                end_msg.type = MSG_HISTORY_END;
-                end_msg.client_id = 0;
-                end_msg.data_len = 0;
-                send(clients[client_id].socket_fd, &end_msg, sizeof(BaseMessage), 0);
                 break;
             }
 
@@ -814,7 +1347,7 @@ void* handle_tcp_client(void* arg) {
                 }
                 roomListMsg.base.data_len = sizeof(RoomListMessage) - sizeof(BaseMessage);
                 pthread_mutex_unlock(&rooms_mutex);
-                send(clients[client_id].socket_fd, &roomListMsg, sizeof(RoomListMessage), 0);
+                send_to_client(client_id, &roomListMsg, sizeof(RoomListMessage));
                 break;
             }
 
@@ -828,9 +1361,16 @@ void* handle_tcp_client(void* arg) {
                         room_id = i;
                         rooms[i].id = i;
                         strcpy(rooms[i].name, req->room_name);
+                        // Older clients send the message without the word filter
+                        if (req->base.data_len >= offsetof(CreateRoomMessage, difficulty) + 1 - sizeof(BaseMessage)) {
+                            req->category[sizeof(req->category) - 1] = '\0';
+                            word_bag_set_filter(&rooms[i].word_bag, req->category, req->difficulty);
+                        } else {
+                            word_bag_set_filter(&rooms[i].word_bag, "", 0);
+                        }
                         rooms[i].client_count = 0;
                         // Initialize room clients
-                        for (int j = 0; j < MAX_CLIENTS; j++) {
+                        for (int j = 0; j < ROOM_SLOTS; j++) {
                             rooms[i].clients[j].socket_fd = -1;
                         }
                         // Add client to room
@@ -858,15 +1398,16 @@ void* handle_tcp_client(void* arg) {
                     strcpy(createdMsg.room_name, rooms[room_id].name);
                     strcpy(createdMsg.nickname, req->nickname);
                     createdMsg.num_players = rooms[room_id].client_count;
-                    send(clients[client_id].socket_fd, &createdMsg, sizeof(RoomCreatedMessage), 0);
+                    send_to_client(client_id, &createdMsg, sizeof(RoomCreatedMessage));
                     printf("Client %d created room %d: %s\n", client_id, room_id, rooms[room_id].name);
+                    ai_player_join(room_id);
                 } else {
                     // Send error message
                     BaseMessage errorMsg;
                     errorMsg.type = MSG_ERROR;
                     errorMsg.client_id = client_id;
                     errorMsg.data_len = 0;
-                    send(clients[client_id].socket_fd, &errorMsg, sizeof(BaseMessage), 0);
+                    send_to_client(client_id, &errorMsg, sizeof(BaseMessage));
                 }
                 break;
             }
@@ -878,9 +1419,9 @@ void* handle_tcp_client(void* arg) {
                 int success = 0;
                 
                 if (room_id >= 0 && room_id < MAX_ROOMS && rooms[room_id].name[0] != '\0') {
-                    if (rooms[room_id].client_count < MAX_CLIENTS) {
+                    if (rooms[room_id].client_count < ROOM_SLOTS) {
                         // Find empty slot in room
-                        for (int i = 0; i < MAX_CLIENTS; i++) {
+                        for (int i = 0; i < ROOM_SLOTS; i++) {
                             if (rooms[room_id].clients[i].socket_fd == -1) {
                                 pthread_mutex_lock(&clients_mutex);
                                 strcpy(clients[client_id].nickname, req->nickname);
@@ -909,7 +1450,7 @@ void* handle_tcp_client(void* arg) {
                     strcpy(joinedMsg.room_name, rooms[room_id].name);
                     strcpy(joinedMsg.nickname, req->nickname);
                     joinedMsg.num_players = rooms[room_id].client_count;
-                    send(clients[client_id].socket_fd, &joinedMsg, sizeof(RoomJoinedMessage), 0);
+                    send_to_client(client_id, &joinedMsg, sizeof(RoomJoinedMessage));
                     printf("Client %d joined room %d: %s\n", client_id, room_id, rooms[room_id].name);
                 } else {
                     // Send error message
@@ -917,19 +1458,20 @@ void* handle_tcp_client(void* arg) {
                     errorMsg.type = MSG_ERROR;
                     errorMsg.client_id = client_id;
                     errorMsg.data_len = 0;
-                    send(clients[client_id].socket_fd, &errorMsg, sizeof(BaseMessage), 0);
+                    send_to_client(client_id, &errorMsg, sizeof(BaseMessage));
                 }
                 break;
             }
 
             case MSG_LEAVE_ROOM: {
                 LeaveRoomMessage* req = (LeaveRoomMessage*)msg;
+                int ai_leaves = 0;
                 pthread_mutex_lock(&rooms_mutex);
                 int room_id = req->room_id;
                 
                 if (room_id >= 0 && room_id < MAX_ROOMS) {
                     // Find and remove client from room
-                    for (int i = 0; i < MAX_CLIENTS; i++) {
+                    for (int i = 0; i < ROOM_SLOTS; i++) {
                         if (rooms[room_id].clients[i].socket_fd == clients[client_id].socket_fd) {
                             // If client was ready, decrease ready_count
                             if (rooms[room_id].clients[i].ready) {
@@ -942,12 +1484,17 @@ void* handle_tcp_client(void* arg) {
                             // If room is empty, clear room name
                             if (rooms[room_id].client_count == 0) {
                                 memset(rooms[room_id].name, 0, sizeof(rooms[room_id].name));
+                                init_game(&rooms[room_id].game);
+                                ai_batch_cancel(room_id);
+                            } else if (room_human_count(&rooms[room_id]) == 0) {
+                                ai_leaves = 1;
                             }
                             break;
                         }
                     }
                 }
                 pthread_mutex_unlock(&rooms_mutex);
+                if (ai_leaves) ai_player_leave(room_id);
                 
                 // Update global client
                 pthread_mutex_lock(&clients_mutex);
@@ -961,7 +1508,7 @@ void* handle_tcp_client(void* arg) {
                 leftMsg.base.client_id = 0;
                 leftMsg.base.data_len = sizeof(RoomLeftMessage) - sizeof(BaseMessage);
                 leftMsg.room_id = room_id;
-                send(clients[client_id].socket_fd, &leftMsg, sizeof(RoomLeftMessage), 0);
+                send_to_client(client_id, &leftMsg, sizeof(RoomLeftMessage));
                 printf("Client %d left room %d (total_clients now: %d)\n", client_id, room_id, rooms[room_id].game.total_clients);
                 break;
             }
@@ -995,7 +1542,7 @@ void* handle_udp_server(void* arg) {
                 // Also update UDP in room clients if in a room
                 if (room_id != -1) {
                     pthread_mutex_lock(&rooms_mutex);
-                    for (int i = 0; i < MAX_CLIENTS; i++) {
+                    for (int i = 0; i < ROOM_SLOTS; i++) {
                         if (rooms[room_id].clients[i].id == cid) {
                             rooms[room_id].clients[i].udp_addr = client_addr;
                             rooms[room_id].clients[i].has_udp_addr = 1;
@@ -1015,30 +1562,20 @@ void* handle_udp_server(void* arg) {
                 
                 // Save drawing data to DB and history for AI
                 if (rooms[room_id].game.state == GAME_PAINTING) {
-                    // Store in drawing_history for AI inference
-                    if (rooms[room_id].history_count < MAX_DRAWING_POINTS) {
-                        rooms[room_id].drawing_history[rooms[room_id].history_count].x = paint_msg->x;
-                        rooms[room_id].drawing_history[rooms[room_id].history_count].y = paint_msg->y;
-                        rooms[room_id].drawing_history[rooms[room_id].history_count].action = paint_msg->action;
-                        rooms[room_id].history_count++;
-                    }
+                    // Store in the round's stroke buffer for AI inference
+                    stroke_buffer_append(&rooms[room_id].strokes, paint_msg->x, paint_msg->y, paint_msg->action,
+                                         paint_msg->color_r, paint_msg->color_g, paint_msg->color_b, now_ms());
                     
-                    char sql_insert[256];
-                    sprintf(sql_insert, "INSERT INTO drawing_data (game_id, x, y, action, color_r, color_g, color_b, timestamp) VALUES (%d, %d, %d, %d, %d, %d, %d, %ld);",
-                            rooms[room_id].game.current_game_id, 
-                            paint_msg->x, paint_msg->y, paint_msg->action,
-                            paint_msg->color_r, paint_msg->color_g, paint_msg->color_b,
-                            time(NULL));
-                    char *err_msg = 0;
-                    // Execute async or just fire and forget for speed? 
-                    // Exec is blocking. For high frequency UDP, this might be slow.
-                    // But let's try.
-                    sqlite3_exec(db, sql_insert, 0, 0, &err_msg);
-                    if (err_msg) sqlite3_free(err_msg);
+                    if (rooms[room_id].live_raster) {
+                        raster_apply(rooms[room_id].live_raster, paint_msg->x, paint_msg->y, paint_msg->action,
+                                     paint_msg->color_r, paint_msg->color_g, paint_msg->color_b);
+                        rooms[room_id].live_points++;
+                        maybe_submit_live_guess(room_id);
+                    }
                 }
 
                 // Broadcast to room clients
-                for (int i = 0; i < MAX_CLIENTS; i++) {
+                for (int i = 0; i < ROOM_SLOTS; i++) {
                         // Forward to everyone except sender (painter)
                         if (rooms[room_id].clients[i].socket_fd != -1 && 
                             rooms[room_id].clients[i].id != cid && 
@@ -1059,16 +1596,24 @@ void* handle_udp_server(void* arg) {
 
 //game timer thread
 void* game_timer(void* arg) {
+    int ticks = 0;
     while (running) {
         sleep(1);// check 1 time per 1 second
+        ticks++;
+        if (ticks % WORD_BANK_POLL_INTERVAL == 0) word_bank_refresh(); // pick up edits to words
+        if (ticks % METRICS_LOG_INTERVAL == 0) {
+            metrics_log();
+            stroke_arena_trim();
+        }
         
         pthread_mutex_lock(&rooms_mutex);
         for (int i = 0; i < MAX_ROOMS; i++) {
             GameInfo* game = &rooms[i].game;
         
             if (game->state == GAME_PAINTING) {//60s
+                maybe_submit_live_guess(i); // flush points drawn since the last live guess
                 time_t elapsed = time(NULL) - game->paint_start_time;
-                if (elapsed >= 60) {
+                if (elapsed >= PAINT_PHASE_SECONDS) {
                     game->state = GAME_GUESSING;
                     game->guess_start_time = time(NULL);
                     printf("Room %d Painting time over, entering guessing phase\n", i);
@@ -1097,7 +1642,7 @@ void* game_timer(void* arg) {
             }
             } else if (game->state == GAME_GUESSING) {//30s
                 time_t elapsed = time(NULL) - game->guess_start_time;
-                if (elapsed >= 30) {
+                if (elapsed >= GUESS_PHASE_SECONDS) {
                     // Temporarily unlock to end game
                     pthread_mutex_unlock(&rooms_mutex);
                     end_game(i);
@@ -1114,7 +1659,7 @@ void* game_timer(void* arg) {
 void cleanup() {
     pthread_mutex_lock(&clients_mutex);
     
-    for (int i = 0; i < MAX_CLIENTS; i++) {
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
         if (clients[i].socket_fd != -1) {
             close(clients[i].socket_fd);
             clients[i].socket_fd = -1;
@@ -1132,8 +1677,13 @@ void cleanup() {
     }
     
     if (db) {
+        db_writer_stop(); // finished rounds still queued get written
+        db_readers_close();
+        db_finalize_statements();
         sqlite3_close(db);
     }
+    
+    ai_sidecar_stop();
 }
 
 // Fully define init_rooms before main
@@ -1142,26 +1692,120 @@ void init_rooms() {
         rooms[i].id = i;
         rooms[i].client_count = 0;
         memset(rooms[i].name, 0, sizeof(rooms[i].name));
-        for (int j = 0; j < MAX_CLIENTS; j++) {
+        for (int j = 0; j < ROOM_SLOTS; j++) {
             rooms[i].clients[j].socket_fd = -1;
         }
         init_game(&rooms[i].game);  // Assuming init_game takes GameInfo*
-        rooms[i].history_count = 0;
+        stroke_buffer_init(&rooms[i].strokes, 0);
+        word_bag_init(&rooms[i].word_bag, (uint32_t)time(NULL) * 2654435761u + i);
+        rooms[i].live_raster = NULL;
+        rooms[i].live_inflight = 0;
+        rooms[i].ai_spent_ms = 0;
         rooms[i].ai_result_ready = 0;
         memset(rooms[i].ai_predicted_word, 0, sizeof(rooms[i].ai_predicted_word));
     }
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    // Offline benchmarks: draw_guess_server --bench raster|index|db|batch
+    if (argc > 2 && strcmp(argv[1], "--bench") == 0) {
+        if (strcmp(argv[2], "raster") == 0) {
+            raster_kernels_benchmark();
+            return 0;
+        }
+        if (strcmp(argv[2], "index") == 0) {
+            embed_index_benchmark(argc > 3 ? argv[3] : "model/text_embeddings.bin");
+            return 0;
+        }
+        if (strcmp(argv[2], "db") == 0) {
+            DbConfig cfg;
+            db_config_defaults(&cfg);
+            db_config_load(argc > 3 ? argv[3] : DB_CONFIG_PATH, &cfg);
+            db_benchmark(&cfg);
+            return 0;
+        }
+        if (strcmp(argv[2], "batch") == 0) {
+            if (argc > 3 && ai_backend_select(argv[3]) != 0) {
+                fprintf(stderr, "Unknown or unavailable AI backend: %s\n", argv[3]);
+                return 1;
+            }
+            if (ai_backend_start() != 0) return 1;
+            ai_batch_benchmark(AI_BATCH_WINDOW_MS, AI_BATCH_MAX);
+            ai_sidecar_stop();
+            return 0;
+        }
+        fprintf(stderr, "Unknown benchmark: %s\n", argv[2]);
+        return 1;
+    }
+    
+    // draw_guess_server [--ai-backend python|python-shm|onnx] [--ai-cache-size N] [--ai-cache-distance BITS]
+    //                   [--ai-player CONFIDENCE_PERCENT] [--db-config PATH]
+    //                   [--import-words FILE]
+    // draw_guess_server --migrate-drawings
+    // draw_guess_server --compact-db
+    int cache_size = AI_CACHE_DEFAULT_SIZE;
+    int cache_distance = AI_CACHE_DEFAULT_DISTANCE;
+    int player_confidence = 0;
+    const char* import_path = NULL;
+    int migrate_drawings = argc == 2 && strcmp(argv[1], "--migrate-drawings") == 0;
+    int compact_db = argc == 2 && strcmp(argv[1], "--compact-db") == 0;
+    for (int i = 1 + migrate_drawings + compact_db; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--ai-backend") == 0) {
+            if (ai_backend_select(argv[i + 1]) != 0) {
+                fprintf(stderr, "Unknown or unavailable AI backend: %s\n", argv[i + 1]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--ai-cache-size") == 0) {
+            cache_size = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--ai-cache-distance") == 0) {
+            cache_distance = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--ai-player") == 0) {
+            player_confidence = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--db-config") == 0) {
+            db_config_path = argv[i + 1];
+        } else if (strcmp(argv[i], "--import-words") == 0) {
+            import_path = argv[i + 1];
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     
-    for (int i = 0; i < MAX_CLIENTS; i++) {
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
         clients[i].socket_fd = -1;
+        pthread_mutex_init(&senders[i].mutex, NULL);
+        senders[i].fd = -1;
     }
     
     init_rooms(); // Initialize rooms
     init_db();
+    if (import_path) {
+        // Offline: load the word list and exit before opening any socket
+        int imported = word_bank_import(db, import_path);
+        cleanup();
+        return imported < 0 ? 1 : 0;
+    }
+    if (migrate_drawings) {
+        int migrated = drawing_migrate(db);
+        cleanup();
+        return migrated < 0 ? 1 : 0;
+    }
+    if (compact_db) {
+        int compacted = retention_compact(db);
+        cleanup();
+        return compacted < 0 ? 1 : 0;
+    }
+    db_writer_start(db);
+    word_bank_load();
+    replay_start(DB_PATH, send_to_client_nowait);
+    retention_start(&db_settings);
+    raster_kernels(); // Pick and verify SIMD kernels before the first round
+    ai_batch_start(AI_BATCH_WINDOW_MS, AI_BATCH_MAX);
+    ai_cache_configure(cache_size, cache_distance);
+    ai_player_start(MAX_ROOMS, player_confidence, attach_ai_client);
     // init_game(); // Removed global game init
     
     //TCP
@@ -1178,6 +1822,10 @@ int main() {
         return 1;
     }
     
+    // Keep server sockets out of the AI sidecar process
+    fcntl(tcp_socket, F_SETFD, FD_CLOEXEC);
+    fcntl(udp_socket, F_SETFD, FD_CLOEXEC);
+    
     int opt = 1;
     setsockopt(tcp_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
     setsockopt(udp_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
@@ -1205,14 +1853,13 @@ int main() {
     
     printf("Listening on port %d\n", SERVER_PORT);
     
-    // Start AI service
-    printf("Starting AI service...\n");
-    #ifdef _WIN32
-    system("start /B python ai_service.py");
-    #else
-    system("python ai_service.py &");
-    #endif
-    sleep(2); // Give AI service time to start
+    // Start AI backend; fall back to ai_service.py if an in-process one
+    // cannot load its model
+    if (ai_backend_start() != 0 && ai_backend() != &ai_backend_python) {
+        printf("AI backend %s unavailable, using python\n", ai_backend()->name);
+        ai_backend_select("python");
+        ai_backend_start();
+    }
     
     pthread_t udp_thread;
     pthread_create(&udp_thread, NULL, handle_udp_server, NULL);
@@ -1235,14 +1882,15 @@ int main() {
             }
             continue;
         }
+        fcntl(client_socket, F_SETFD, FD_CLOEXEC);
         
         printf("Client connected: %s:%d\n", inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
         
-        int client_id = add_client(client_socket);
+        int client_id = add_client(client_socket, 0);
         
         if (client_id != -1) {
             pthread_t client_thread;
-            pthread_create(&client_thread, NULL, handle_tcp_client, &client_id);
+            pthread_create(&client_thread, NULL, handle_tcp_client, &clients[client_id].id);
             pthread_detach(client_thread);
         } else {
 
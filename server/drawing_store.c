@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "db.h"
+#include "drawing_store.h"
+
+#define TAG_ACTION_MASK 0x07
+#define TAG_ACTION_ESCAPE 0x07
+#define TAG_COLOR 0x08
+
+static uint8_t* put_varint(uint8_t* p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int get_varint(DrawingDecoder* dec, uint32_t* v) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (dec->p >= dec->end) return -1;
+        uint8_t b = *dec->p++;
+        result |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+uint8_t* drawing_encode(const StrokeBuffer* buf, size_t* len) {
+    *len = 0;
+    if (buf->count == 0) return NULL;
+    uint8_t* out = malloc((size_t)buf->count * DRAWING_POINT_MAX_BYTES);
+    if (!out) return NULL;
+
+    uint8_t* p = out;
+    StrokePoint prev = {0};
+    for (const StrokeChunk* chunk = buf->head; chunk; chunk = chunk->next) {
+        for (int i = 0; i < chunk->count; i++) {
+            const StrokePoint* pt = &chunk->points[i];
+            int color = pt->color_r != prev.color_r || pt->color_g != prev.color_g || pt->color_b != prev.color_b;
+            uint8_t action = pt->action < TAG_ACTION_ESCAPE ? pt->action : TAG_ACTION_ESCAPE;
+            *p++ = action | (color ? TAG_COLOR : 0);
+            if (action == TAG_ACTION_ESCAPE) *p++ = pt->action;
+            p = put_varint(p, zigzag((int32_t)pt->x - prev.x));
+            p = put_varint(p, zigzag((int32_t)pt->y - prev.y));
+            p = put_varint(p, zigzag((int32_t)(pt->t_ms - prev.t_ms)));
+            if (color) {
+                *p++ = pt->color_r;
+                *p++ = pt->color_g;
+                *p++ = pt->color_b;
+            }
+            prev = *pt;
+        }
+    }
+    *len = (size_t)(p - out);
+    uint8_t* shrunk = realloc(out, *len);
+    return shrunk ? shrunk : out;
+}
+
+void drawing_decoder_init(DrawingDecoder* dec, const uint8_t* data, size_t len) {
+    dec->p = data;
+    dec->end = data + len;
+    memset(&dec->prev, 0, sizeof(dec->prev));
+}
+
+void drawing_decoder_feed(DrawingDecoder* dec, const uint8_t* data, size_t len) {
+    dec->p = data;
+    dec->end = data + len;
+}
+
+int drawing_decoder_next(DrawingDecoder* dec, StrokePoint* out) {
+    if (dec->p >= dec->end) return 0;
+    uint8_t tag = *dec->p++;
+    StrokePoint pt = dec->prev;
+    pt.action = tag & TAG_ACTION_MASK;
+    if (pt.action == TAG_ACTION_ESCAPE) {
+        if (dec->p >= dec->end) return -1;
+        pt.action = *dec->p++;
+    }
+    uint32_t dx, dy, dt;
+    if (get_varint(dec, &dx) || get_varint(dec, &dy) || get_varint(dec, &dt)) return -1;
+    pt.x = (uint16_t)(pt.x + unzigzag(dx));
+    pt.y = (uint16_t)(pt.y + unzigzag(dy));
+    pt.t_ms += (uint32_t)unzigzag(dt);
+    if (tag & TAG_COLOR) {
+        if (dec->end - dec->p < 3) return -1;
+        pt.color_r = dec->p[0];
+        pt.color_g = dec->p[1];
+        pt.color_b = dec->p[2];
+        dec->p += 3;
+    }
+    dec->prev = pt;
+    *out = pt;
+    return 1;
+}
+
+int drawing_save(const DrawingInfo* info, const StrokeBuffer* buf) {
+    size_t len;
+    uint8_t* blob = drawing_encode(buf, &len);
+    if (!blob) return -1;
+
+    int rc = -1;
+    sqlite3_stmt* stmt = db_stmt_acquire(DB_STMT_INSERT_DRAWING);
+    if (stmt) {
+        sqlite3_bind_int(stmt, 1, info->game_id);
+        sqlite3_bind_int(stmt, 2, info->room_id);
+        sqlite3_bind_text(stmt, 3, info->word, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 4, info->points);
+        sqlite3_bind_int64(stmt, 5, info->duration_ms);
+        sqlite3_bind_int(stmt, 6, DRAWING_FORMAT);
+        sqlite3_bind_blob(stmt, 7, blob, (int)len, SQLITE_STATIC);
+        rc = sqlite3_step(stmt) == SQLITE_DONE ? 0 : -1;
+    }
+    db_stmt_release(DB_STMT_INSERT_DRAWING);
+    free(blob);
+    return rc;
+}
+
+// Word of a legacy game, from its history rows
+static void legacy_word(sqlite3* conn, int game_id, char* word, size_t size) {
+    sqlite3_stmt* stmt;
+    word[0] = '\0';
+    if (sqlite3_prepare_v2(conn, "SELECT word FROM history WHERE game_id = ? LIMIT 1;", -1, &stmt, NULL) != SQLITE_OK) return;
+    sqlite3_bind_int(stmt, 1, game_id);
+    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0)) {
+        snprintf(word, size, "%s", (const char*)sqlite3_column_text(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+}
+
+static int legacy_flush(sqlite3* conn, DrawingInfo* info, StrokeBuffer* buf) {
+    if (buf->count == 0) return 0;
+    legacy_word(conn, info->game_id, info->word, sizeof(info->word));
+    info->points = buf->count;
+    info->duration_ms = buf->tail->points[buf->tail->count - 1].t_ms;
+    int rc = drawing_save(info, buf);
+    stroke_buffer_release(buf);
+    return rc;
+}
+
+int drawing_migrate(sqlite3* conn) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(conn, "SELECT game_id, x, y, action, color_r, color_g, color_b, timestamp"
+                                 " FROM drawing_data ORDER BY game_id, id;", -1, &stmt, NULL) != SQLITE_OK) {
+        printf("No drawing_data table to migrate\n");
+        return 0;
+    }
+
+    sqlite3_exec(conn, "BEGIN;", 0, 0, 0);
+    StrokeBuffer buf;
+    stroke_buffer_init(&buf, 0);
+    DrawingInfo info = { .game_id = 0, .room_id = -1 };
+    long long first_ts = 0;
+    int games = 0, rows = 0, failed = 0;
+    while (!failed && sqlite3_step(stmt) == SQLITE_ROW) {
+        int game_id = sqlite3_column_int(stmt, 0);
+        long long ts = sqlite3_column_int64(stmt, 7);
+        if (rows == 0 || game_id != info.game_id) {
+            if (legacy_flush(conn, &info, &buf) != 0) failed = 1;
+            if (rows > 0) games++;
+            info.game_id = game_id;
+            first_ts = ts;
+        }
+        // Legacy timestamps are whole seconds
+        stroke_buffer_append(&buf, (uint16_t)sqlite3_column_int(stmt, 1), (uint16_t)sqlite3_column_int(stmt, 2),
+                             (uint8_t)sqlite3_column_int(stmt, 3), (uint8_t)sqlite3_column_int(stmt, 4),
+                             (uint8_t)sqlite3_column_int(stmt, 5), (uint8_t)sqlite3_column_int(stmt, 6),
+                             ts > first_ts ? (ts - first_ts) * 1000 : 0);
+        rows++;
+    }
+    sqlite3_finalize(stmt);
+    if (!failed && rows > 0) {
+        if (legacy_flush(conn, &info, &buf) != 0) failed = 1;
+        games++;
+    }
+    stroke_buffer_release(&buf);
+
+    if (failed || sqlite3_exec(conn, "DROP TABLE drawing_data; COMMIT;", 0, 0, 0) != SQLITE_OK) {
+        fprintf(stderr, "SQL error (migrate drawings): %s\n", sqlite3_errmsg(conn));
+        sqlite3_exec(conn, "ROLLBACK;", 0, 0, 0);
+        return -1;
+    }
+    printf("Migrated %d points of %d games from drawing_data\n", rows, games);
+    return games;
+}
@@ -0,0 +1,54 @@
+#ifndef DRAWING_STORE_H
+#define DRAWING_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sqlite3.h"
+#include "stroke_buffer.h"
+
+// One row per round in the drawings table: the stroke stream packed as
+// deltas plus metadata, written once when the round ends.
+//
+// Format 1, per point: a tag byte (action in the low 3 bits, 7 = escape
+// followed by the raw action byte; 0x08 = colour follows), zigzag varints
+// for dx, dy and dt_ms against the previous point, then r, g, b if the
+// colour changed. A stroke of nearby points costs 4-5 bytes instead of a
+// 10-column row.
+
+#define DRAWING_FORMAT 1
+#define DRAWING_POINT_MAX_BYTES 16 // tag + escape + 3 varints + colour
+
+typedef struct {
+    int game_id;
+    int room_id;
+    char word[32];
+    int points;
+    uint32_t duration_ms;
+} DrawingInfo;
+
+// Pack buf into a malloc'd blob; NULL on failure (or no points)
+uint8_t* drawing_encode(const StrokeBuffer* buf, size_t* len);
+
+// Streaming decoder, so callers can walk a blob without materialising it
+typedef struct {
+    const uint8_t* p;
+    const uint8_t* end;
+    StrokePoint prev;
+} DrawingDecoder;
+
+void drawing_decoder_init(DrawingDecoder* dec, const uint8_t* data, size_t len);
+// Continue from the point the decoder stopped at in a new buffer, for
+// blobs read in chunks; feed at least DRAWING_POINT_MAX_BYTES unless it
+// is the tail of the blob
+void drawing_decoder_feed(DrawingDecoder* dec, const uint8_t* data, size_t len);
+// 1 with *out filled, 0 at the end, -1 on a corrupt blob
+int drawing_decoder_next(DrawingDecoder* dec, StrokePoint* out);
+
+// Store the round (writer connection, caller holds any transaction)
+int drawing_save(const DrawingInfo* info, const StrokeBuffer* buf);
+
+// draw_guess_server --migrate-drawings: pack the legacy per-point
+// drawing_data table into drawings, one transaction, then drop it
+int drawing_migrate(sqlite3* conn);
+
+#endif
@@ -0,0 +1,634 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "embed_index.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EMBED_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+// ---- Float dot-product kernels: scores[r] = matrix[r] . query ----
+
+typedef void (*ScoreRowsFn)(const float* matrix, int rows, int dim, const float* query, float* scores);
+
+static void score_rows_scalar(const float* matrix, int rows, int dim, const float* query, float* scores) {
+    for (int r = 0; r < rows; r++) {
+        const float* row = matrix + (size_t)r * dim;
+        float sum = 0.0f;
+        for (int i = 0; i < dim; i++) sum += row[i] * query[i];
+        scores[r] = sum;
+    }
+}
+
+// ---- fp16 rows, only read for the re-rank shortlist ----
+
+// Round to nearest even; embeddings are unit vectors, so overflow is moot
+static uint16_t float_to_half(float value) {
+    uint32_t f;
+    memcpy(&f, &value, sizeof(f));
+    uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+    uint16_t h;
+    if (f >= 0x47800000u) { // too large, inf or nan
+        h = f > 0x7f800000u ? 0x7e00 : 0x7c00;
+    } else if (f < 0x38800000u) { // subnormal or zero: let the FPU round
+        float v;
+        memcpy(&v, &f, sizeof(v));
+        v += 0.5f;
+        memcpy(&f, &v, sizeof(f));
+        h = (uint16_t)(f - 0x3f000000u);
+    } else {
+        uint32_t odd = (f >> 13) & 1;
+        f += ((uint32_t)(15 - 127) << 23) + 0xfff + odd;
+        h = (uint16_t)(f >> 13);
+    }
+    return h | (uint16_t)(sign >> 16);
+}
+
+static float half_to_float(uint16_t h) {
+    uint32_t o = (uint32_t)(h & 0x7fff) << 13;
+    uint32_t exp = o & 0x0f800000u;
+    o += (uint32_t)(127 - 15) << 23;
+    float f;
+    if (exp == 0x0f800000u) { // inf or nan
+        o += (uint32_t)(128 - 16) << 23;
+        memcpy(&f, &o, sizeof(f));
+    } else if (exp == 0) { // subnormal or zero
+        uint32_t magic = 113u << 23;
+        float m;
+        o += 1u << 23;
+        memcpy(&f, &o, sizeof(f));
+        memcpy(&m, &magic, sizeof(m));
+        f -= m;
+    } else {
+        memcpy(&f, &o, sizeof(f));
+    }
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    bits |= (uint32_t)(h & 0x8000) << 16;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static void score_rows_f16(const uint16_t* matrix, int rows, int dim, const float* query, float* scores) {
+    for (int r = 0; r < rows; r++) {
+        const uint16_t* row = matrix + (size_t)r * dim;
+        float s = 0.0f;
+        for (int i = 0; i < dim; i++) s += half_to_float(row[i]) * query[i];
+        scores[r] = s;
+    }
+}
+
+// ---- int8 dot-product kernels: dots[r] = qmatrix[r] . qquery ----
+// Values are kept in [-127, 127] so |q| * sign(row, q) never saturates
+// the unsigned x signed byte multiplies.
+
+typedef void (*ScoreRowsI8Fn)(const int8_t* matrix, int rows, int dim, const int8_t* query, int32_t* dots);
+
+static void score_rows_i8_scalar(const int8_t* matrix, int rows, int dim, const int8_t* query, int32_t* dots) {
+    for (int r = 0; r < rows; r++) {
+        const int8_t* row = matrix + (size_t)r * dim;
+        int32_t sum = 0;
+        for (int i = 0; i < dim; i++) sum += (int32_t)row[i] * query[i];
+        dots[r] = sum;
+    }
+}
+
+#ifdef EMBED_HAVE_X86
+__attribute__((target("avx2,fma")))
+static float hsum256(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+// Two rows per pass so each query load feeds two FMAs
+__attribute__((target("avx2,fma")))
+static void score_rows_avx2(const float* matrix, int rows, int dim, const float* query, float* scores) {
+    int r = 0;
+    for (; r + 2 <= rows; r += 2) {
+        const float* a = matrix + (size_t)r * dim;
+        const float* b = a + dim;
+        __m256 acc_a = _mm256_setzero_ps();
+        __m256 acc_b = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 8 <= dim; i += 8) {
+            __m256 q = _mm256_loadu_ps(query + i);
+            acc_a = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), q, acc_a);
+            acc_b = _mm256_fmadd_ps(_mm256_loadu_ps(b + i), q, acc_b);
+        }
+        float sa = hsum256(acc_a), sb = hsum256(acc_b);
+        for (; i < dim; i++) {
+            sa += a[i] * query[i];
+            sb += b[i] * query[i];
+        }
+        scores[r] = sa;
+        scores[r + 1] = sb;
+    }
+    if (r < rows) score_rows_scalar(matrix + (size_t)r * dim, rows - r, dim, query, scores + r);
+}
+
+__attribute__((target("avx2")))
+static int32_t hsum256_epi32(__m256i v) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+}
+
+static int32_t dot_i8_tail(const int8_t* row, const int8_t* query, int from, int dim) {
+    int32_t sum = 0;
+    for (int i = from; i < dim; i++) sum += (int32_t)row[i] * query[i];
+    return sum;
+}
+
+// maddubs(|q|, sign(row, q)) gives 16-bit pair sums, madd widens to 32
+__attribute__((target("avx2")))
+static void score_rows_i8_avx2(const int8_t* matrix, int rows, int dim, const int8_t* query, int32_t* dots) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (int r = 0; r < rows; r++) {
+        const int8_t* row = matrix + (size_t)r * dim;
+        __m256i acc = _mm256_setzero_si256();
+        int i = 0;
+        for (; i + 32 <= dim; i += 32) {
+            __m256i q = _mm256_loadu_si256((const __m256i*)(query + i));
+            __m256i m = _mm256_loadu_si256((const __m256i*)(row + i));
+            __m256i prod = _mm256_maddubs_epi16(_mm256_sign_epi8(q, q), _mm256_sign_epi8(m, q));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(prod, ones));
+        }
+        dots[r] = hsum256_epi32(acc) + dot_i8_tail(row, query, i, dim);
+    }
+}
+
+#if __GNUC__ >= 11
+// Same trick with the fused u8 x s8 -> s32 VNNI instruction
+#define SCORE_ROWS_I8_VNNI(name, target_isa, dpbusd)                                          \
+    __attribute__((target(target_isa)))                                                      \
+    static void name(const int8_t* matrix, int rows, int dim, const int8_t* query, int32_t* dots) { \
+        for (int r = 0; r < rows; r++) {                                                     \
+            const int8_t* row = matrix + (size_t)r * dim;                                    \
+            __m256i acc = _mm256_setzero_si256();                                            \
+            int i = 0;                                                                       \
+            for (; i + 32 <= dim; i += 32) {                                                 \
+                __m256i q = _mm256_loadu_si256((const __m256i*)(query + i));                 \
+                __m256i m = _mm256_loadu_si256((const __m256i*)(row + i));                   \
+                acc = dpbusd(acc, _mm256_sign_epi8(q, q), _mm256_sign_epi8(m, q));           \
+            }                                                                                \
+            dots[r] = hsum256_epi32(acc) + dot_i8_tail(row, query, i, dim);                  \
+        }                                                                                    \
+    }
+
+SCORE_ROWS_I8_VNNI(score_rows_i8_avxvnni, "avx2,avxvnni", _mm256_dpbusd_avx_epi32)
+SCORE_ROWS_I8_VNNI(score_rows_i8_avx512vnni, "avx2,avx512vl,avx512vnni", _mm256_dpbusd_epi32)
+#define EMBED_HAVE_VNNI 1
+#endif
+#endif // EMBED_HAVE_X86
+
+static ScoreRowsFn score_rows_fn(void) {
+    static ScoreRowsFn fn = NULL;
+    ScoreRowsFn f = __atomic_load_n(&fn, __ATOMIC_ACQUIRE);
+    if (!f) {
+        f = score_rows_scalar;
+#ifdef EMBED_HAVE_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) f = score_rows_avx2;
+#endif
+        __atomic_store_n(&fn, f, __ATOMIC_RELEASE);
+    }
+    return f;
+}
+
+static const char* score_rows_i8_name = "scalar";
+
+static ScoreRowsI8Fn score_rows_i8_fn(void) {
+    static ScoreRowsI8Fn fn = NULL;
+    ScoreRowsI8Fn f = __atomic_load_n(&fn, __ATOMIC_ACQUIRE);
+    if (!f) {
+        f = score_rows_i8_scalar;
+#ifdef EMBED_HAVE_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            f = score_rows_i8_avx2;
+            score_rows_i8_name = "avx2";
+        }
+#ifdef EMBED_HAVE_VNNI
+        if (__builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512vl")) {
+            f = score_rows_i8_avx512vnni;
+            score_rows_i8_name = "avx512-vnni";
+        } else if (__builtin_cpu_supports("avxvnni")) {
+            f = score_rows_i8_avxvnni;
+            score_rows_i8_name = "avx-vnni";
+        }
+#endif
+#endif
+        __atomic_store_n(&fn, f, __ATOMIC_RELEASE);
+    }
+    return f;
+}
+
+// ---- Index ----
+
+static EmbedIndex* index_create(uint32_t set_id, int count, int dim, float logit_scale,
+                                float* matrix, char* words, int quantize) {
+    EmbedIndex* idx = calloc(1, sizeof(EmbedIndex));
+    const char** word = malloc(sizeof(char*) * (count ? count : 1));
+    if (!idx || !word) {
+        free(idx);
+        free(word);
+        free(matrix);
+        free(words);
+        return NULL;
+    }
+    const char* p = words;
+    for (int i = 0; i < count; i++) {
+        word[i] = p;
+        p += strlen(p) + 1;
+    }
+    idx->set_id = set_id;
+    idx->count = count;
+    idx->dim = dim;
+    idx->logit_scale = logit_scale;
+    idx->matrix = matrix;
+    idx->words = words;
+    idx->word = word;
+    idx->refs = 1;
+    if (quantize) embed_index_quantize(idx);
+    return idx;
+}
+
+EmbedIndex* embed_index_create(uint32_t set_id, int count, int dim, float logit_scale,
+                               float* matrix, char* words) {
+    return index_create(set_id, count, dim, logit_scale, matrix, words, count >= EMBED_QUANTIZE_MIN_WORDS);
+}
+
+// Symmetric quantization to [-127, 127]; returns the dequantization scale
+static float quantize_row(const float* src, int dim, int8_t* dst) {
+    float max_abs = 0.0f;
+    for (int i = 0; i < dim; i++) {
+        float a = fabsf(src[i]);
+        if (a > max_abs) max_abs = a;
+    }
+    if (max_abs == 0.0f) {
+        memset(dst, 0, dim);
+        return 0.0f;
+    }
+    float inv = 127.0f / max_abs;
+    for (int i = 0; i < dim; i++) {
+        dst[i] = (int8_t)lrintf(src[i] * inv);
+    }
+    return max_abs / 127.0f;
+}
+
+void embed_index_quantize(EmbedIndex* idx) {
+    if (idx->qmatrix) return;
+    size_t cells = (size_t)idx->count * idx->dim;
+    size_t float_bytes = embed_index_bytes(idx);
+    int8_t* q = malloc(cells);
+    float* scale = malloc(sizeof(float) * idx->count);
+    uint16_t* half = malloc(sizeof(uint16_t) * cells);
+    if (!q || !scale || !half) {
+        free(q);
+        free(scale);
+        free(half);
+        return;
+    }
+    for (int r = 0; r < idx->count; r++) {
+        scale[r] = quantize_row(idx->matrix + (size_t)r * idx->dim, idx->dim, q + (size_t)r * idx->dim);
+    }
+    for (size_t i = 0; i < cells; i++) half[i] = float_to_half(idx->matrix[i]);
+    free(idx->matrix);
+    idx->matrix = NULL;
+    idx->qmatrix = q;
+    idx->qscale = scale;
+    idx->hmatrix = half;
+    score_rows_i8_fn(); // resolves score_rows_i8_name
+    printf("Embed index %08x: %d words, %zu KB as float, now %zu KB as int8 + fp16 (%s)\n", idx->set_id,
+           idx->count, float_bytes / 1024, embed_index_bytes(idx) / 1024, score_rows_i8_name);
+}
+
+size_t embed_index_bytes(const EmbedIndex* idx) {
+    size_t cells = (size_t)idx->count * idx->dim;
+    size_t bytes = 0;
+    if (idx->matrix) bytes += sizeof(float) * cells;
+    if (idx->qmatrix) bytes += cells + sizeof(float) * idx->count;
+    if (idx->hmatrix) bytes += sizeof(uint16_t) * cells;
+    return bytes;
+}
+
+void embed_index_retain(EmbedIndex* idx) {
+    __atomic_add_fetch(&idx->refs, 1, __ATOMIC_RELAXED);
+}
+
+void embed_index_release(EmbedIndex* idx) {
+    if (!idx) return;
+    if (__atomic_sub_fetch(&idx->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(idx->matrix);
+        free(idx->words);
+        free(idx->word);
+        free(idx->qmatrix);
+        free(idx->qscale);
+        free(idx->hmatrix);
+        free(idx);
+    }
+}
+
+int embed_index_find(const EmbedIndex* idx, const char* word) {
+    for (int i = 0; i < idx->count; i++) {
+        if (strcmp(idx->word[i], word) == 0) return i;
+    }
+    return -1;
+}
+
+// Insert row r with the given score into out[0..*found) kept descending,
+// capped at k entries
+static void topk_push(const float* scores, int r, int k, int* found, int* out) {
+    float s = scores[r];
+    if (*found == k && s <= scores[out[k - 1]]) return;
+    int pos = *found < k ? (*found)++ : k - 1;
+    while (pos > 0 && scores[out[pos - 1]] < s) {
+        out[pos] = out[pos - 1];
+        pos--;
+    }
+    out[pos] = r;
+}
+
+// Fill scores[] with the cosine of every row. On the int8 path these are
+// approximations, except for the re-ranked shortlist scored on fp16 rows.
+static void score_all(const EmbedIndex* idx, const float* query, float* scores, int rerank) {
+    if (!idx->qmatrix) {
+        score_rows_fn()(idx->matrix, idx->count, idx->dim, query, scores);
+        return;
+    }
+
+    int8_t* qquery = malloc(idx->dim);
+    int32_t* dots = malloc(sizeof(int32_t) * idx->count);
+    if (!qquery || !dots) {
+        free(qquery);
+        free(dots);
+        score_rows_f16(idx->hmatrix, idx->count, idx->dim, query, scores);
+        return;
+    }
+    float qs = quantize_row(query, idx->dim, qquery);
+    score_rows_i8_fn()(idx->qmatrix, idx->count, idx->dim, qquery, dots);
+    for (int r = 0; r < idx->count; r++) {
+        scores[r] = (float)dots[r] * qs * idx->qscale[r];
+    }
+    free(qquery);
+    free(dots);
+
+    int k = idx->count < rerank ? idx->count : rerank;
+    int* shortlist = malloc(sizeof(int) * (k > 0 ? k : 1));
+    if (!shortlist) return; // approximate scores only
+    int found = 0;
+    for (int r = 0; r < idx->count && k > 0; r++) {
+        topk_push(scores, r, k, &found, shortlist);
+    }
+    for (int i = 0; i < found; i++) {
+        int r = shortlist[i];
+        score_rows_f16(idx->hmatrix + (size_t)r * idx->dim, 1, idx->dim, query, &scores[r]);
+    }
+    free(shortlist);
+}
+
+static int rank_with(const EmbedIndex* idx, const float* query, int k, EmbedMatch* out,
+                     int target_index, float* target_prob, int rerank) {
+    if (idx->count == 0 || k <= 0) return 0;
+    float* scores = malloc(sizeof(float) * idx->count);
+    int* top = malloc(sizeof(int) * (k < idx->count ? k : idx->count));
+    if (!scores || !top) {
+        free(scores);
+        free(top);
+        return 0;
+    }
+    score_all(idx, query, scores, rerank);
+    if (idx->qmatrix && target_index >= 0 && target_index < idx->count) {
+        score_rows_f16(idx->hmatrix + (size_t)target_index * idx->dim, 1, idx->dim, query, &scores[target_index]);
+    }
+
+    if (k > idx->count) k = idx->count;
+    int found = 0;
+    float best = -INFINITY;
+    for (int r = 0; r < idx->count; r++) {
+        if (scores[r] > best) best = scores[r];
+        topk_push(scores, r, k, &found, top);
+    }
+
+    // Softmax over logit_scale * cosine, shifted by the max for stability
+    double denom = 0.0;
+    for (int r = 0; r < idx->count; r++) {
+        denom += exp((double)idx->logit_scale * (scores[r] - best));
+    }
+    for (int i = 0; i < found; i++) {
+        out[i].index = top[i];
+        out[i].prob = (float)(exp((double)idx->logit_scale * (scores[top[i]] - best)) / denom);
+    }
+    if (target_prob) {
+        *target_prob = 0.0f;
+        if (target_index >= 0 && target_index < idx->count) {
+            *target_prob = (float)(exp((double)idx->logit_scale * (scores[target_index] - best)) / denom);
+        }
+    }
+    free(scores);
+    free(top);
+    return found;
+}
+
+int embed_index_rank(const EmbedIndex* idx, const float* query, int k, EmbedMatch* out,
+                     int target_index, float* target_prob) {
+    return rank_with(idx, query, k, out, target_index, target_prob, EMBED_RERANK);
+}
+
+static EmbedIndex* load_table(const char* path, uint32_t set_id, int quantize) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    EmbedTableHeader h;
+    float* matrix = NULL;
+    char* words = NULL;
+    int ok = fread(&h, sizeof(h), 1, f) == 1 && h.magic == EMBED_TABLE_MAGIC && h.count > 0 && h.dim > 0;
+    if (ok) {
+        size_t floats = (size_t)h.count * h.dim;
+        words = malloc(h.words_len + 1);
+        matrix = malloc(sizeof(float) * floats);
+        ok = words && matrix && fread(words, 1, h.words_len, f) == h.words_len &&
+             fread(matrix, sizeof(float), floats, f) == floats;
+    }
+    fclose(f);
+    if (ok) {
+        // Exactly count NUL-terminated words
+        words[h.words_len] = '\0';
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < h.words_len; i++) n += words[i] == '\0';
+        ok = n >= h.count;
+    }
+    if (!ok) {
+        free(matrix);
+        free(words);
+        return NULL;
+    }
+    return index_create(set_id, (int)h.count, (int)h.dim, h.logit_scale, matrix, words,
+                        quantize && h.count >= EMBED_QUANTIZE_MIN_WORDS);
+}
+
+EmbedIndex* embed_index_load(const char* path, uint32_t set_id) {
+    return load_table(path, set_id, 1);
+}
+
+// ---- Benchmark ----
+
+static uint32_t bench_rng = 12345;
+
+static float bench_gauss(void) {
+    // Sum of uniforms is close enough to normal for synthetic embeddings
+    float s = 0.0f;
+    for (int i = 0; i < 4; i++) {
+        bench_rng = bench_rng * 1664525u + 1013904223u;
+        s += (float)(bench_rng >> 8) / 16777216.0f - 0.5f;
+    }
+    return s;
+}
+
+static void bench_normalize(float* v, int dim) {
+    float n = 0.0f;
+    for (int i = 0; i < dim; i++) n += v[i] * v[i];
+    n = 1.0f / sqrtf(n);
+    for (int i = 0; i < dim; i++) v[i] *= n;
+}
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Word rows scattered tightly around a few shared directions: each query
+// has a thousand near-ties, far more than the re-rank shortlist holds, so
+// int8 rounding decides which of them get re-scored
+static float* bench_clustered(int count, int dim, int clusters, float spread) {
+    float* matrix = malloc(sizeof(float) * (size_t)count * dim);
+    float* centres = malloc(sizeof(float) * (size_t)clusters * dim);
+    if (!matrix || !centres) {
+        free(matrix);
+        free(centres);
+        return NULL;
+    }
+    for (int c = 0; c < clusters; c++) {
+        for (int i = 0; i < dim; i++) centres[(size_t)c * dim + i] = bench_gauss();
+        bench_normalize(centres + (size_t)c * dim, dim);
+    }
+    float noise = spread / sqrtf((float)dim / 3.0f); // bench_gauss() has variance 1/3
+    for (int r = 0; r < count; r++) {
+        const float* centre = centres + (size_t)(r % clusters) * dim;
+        for (int i = 0; i < dim; i++) matrix[(size_t)r * dim + i] = centre[i] + noise * bench_gauss();
+        bench_normalize(matrix + (size_t)r * dim, dim);
+    }
+    free(centres);
+    return matrix;
+}
+
+// Float vs int8 ranking for queries between a word row and noise, like an
+// image embedding (cosine ~0.3 to its word); recall is reported for several
+// shortlist sizes
+#define BENCH_QUERY_NOISE 3.0f // noise norm against a unit word row
+
+static void bench_index(const char* label, const EmbedIndex* ref) {
+    const int queries = 100, k = 10;
+    static const int reranks[] = { 10, 16, EMBED_RERANK, 256 };
+    const int n_reranks = sizeof(reranks) / sizeof(reranks[0]);
+    int dim = ref->dim, count = ref->count;
+
+    // The quantized index gets its own copy; ref keeps the float rows for
+    // the exact ranking
+    size_t cells = (size_t)count * dim;
+    size_t words_len = (size_t)(ref->word[count - 1] - ref->words) + strlen(ref->word[count - 1]) + 1;
+    float* matrix = malloc(sizeof(float) * cells);
+    char* words = malloc(words_len);
+    float* query = malloc(sizeof(float) * dim);
+    if (!matrix || !words || !query) {
+        free(matrix);
+        free(words);
+        free(query);
+        return;
+    }
+    memcpy(matrix, ref->matrix, sizeof(float) * cells);
+    memcpy(words, ref->words, words_len);
+    EmbedIndex* idx = index_create(0, count, dim, ref->logit_scale, matrix, words, 1);
+    if (!idx || !idx->qmatrix) {
+        embed_index_release(idx);
+        free(query);
+        return;
+    }
+
+    EmbedMatch exact[11], approx[10];
+    double t_float = 0.0, t_int8 = 0.0, margin = 0.0;
+    int hits[4] = { 0 }, top1[4] = { 0 };
+    float noise = BENCH_QUERY_NOISE / sqrtf((float)dim / 3.0f);
+    for (int q = 0; q < queries; q++) {
+        const float* base = ref->matrix + (size_t)((q * 7919) % count) * dim;
+        for (int i = 0; i < dim; i++) query[i] = base[i] + noise * bench_gauss();
+        bench_normalize(query, dim);
+
+        double t0 = bench_now();
+        int found = rank_with(ref, query, k + 1, exact, -1, NULL, 0);
+        t_float += bench_now() - t0;
+        // Cosine gap between the k-th and (k+1)-th word, from the softmax ratio
+        if (found > k && exact[k].prob > 0.0f) margin += log(exact[k - 1].prob / exact[k].prob) / ref->logit_scale;
+
+        for (int r = 0; r < n_reranks; r++) {
+            double t1 = bench_now();
+            rank_with(idx, query, k, approx, -1, NULL, reranks[r]);
+            if (reranks[r] == EMBED_RERANK) t_int8 += bench_now() - t1;
+            for (int i = 0; i < k; i++) {
+                for (int j = 0; j < k; j++) {
+                    if (exact[i].index == approx[j].index) {
+                        hits[r]++;
+                        break;
+                    }
+                }
+            }
+            if (exact[0].index == approx[0].index) top1[r]++;
+        }
+    }
+
+    printf("Embed index benchmark, %s (%d words x %d dims, %d queries):\n", label, count, dim, queries);
+    printf("  float  %8zu KB  %7.3f ms/query\n", embed_index_bytes(ref) / 1024, t_float * 1000.0 / queries);
+    printf("  int8   %8zu KB  %7.3f ms/query  (%s, re-rank %d)\n", embed_index_bytes(idx) / 1024,
+           t_int8 * 1000.0 / queries, score_rows_i8_name, EMBED_RERANK);
+    printf("         = int8 rows %zu KB + scales %zu KB + fp16 re-rank rows %zu KB\n", cells / 1024,
+           sizeof(float) * (size_t)count / 1024, sizeof(uint16_t) * cells / 1024);
+    printf("  mean cosine gap #%d-#%d %.5f\n", k, k + 1, margin / queries);
+    for (int r = 0; r < n_reranks; r++) {
+        printf("  re-rank %3d candidates: recall@%d %.4f  top-1 agreement %.4f%s\n", reranks[r], k,
+               (double)hits[r] / (queries * k), (double)top1[r] / queries,
+               reranks[r] == EMBED_RERANK ? "  (used)" : "");
+    }
+    embed_index_release(idx);
+    free(query);
+}
+
+void embed_index_benchmark(const char* table_path) {
+    const int count = 50000, dim = 512;
+    float* matrix = bench_clustered(count, dim, count / 1000, 0.1f);
+    char* words = calloc(count, 1); // count empty words
+    if (!matrix || !words) {
+        free(matrix);
+        free(words);
+        return;
+    }
+    EmbedIndex* ref = index_create(0, count, dim, 100.0f, matrix, words, 0);
+    if (ref) {
+        bench_index("clustered synthetic", ref);
+        embed_index_release(ref);
+    }
+
+    ref = load_table(table_path, 0, 0);
+    if (!ref) {
+        printf("(%s not found; run export_onnx.py to measure model embeddings)\n", table_path);
+        return;
+    }
+    bench_index(table_path, ref);
+    embed_index_release(ref);
+}
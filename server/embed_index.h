@@ -0,0 +1,76 @@
+#ifndef EMBED_INDEX_H
+#define EMBED_INDEX_H
+
+#include <stdint.h>
+
+// Word text embeddings of one candidate set, stored as a contiguous
+// row-major count x dim matrix of L2-normalized floats. Built once per
+// candidate set and shared read-only by AI threads (reference counted).
+//
+// Large word banks are held as int8 rows (per-row scale) plus fp16 rows
+// instead of the float matrix: the int8 rows are scanned first, then the
+// best EMBED_RERANK candidates are re-scored against the fp16 rows.
+
+#define EMBED_QUANTIZE_MIN_WORDS 2048
+#define EMBED_RERANK 64
+
+typedef struct {
+    uint32_t set_id;
+    int count;
+    int dim;
+    float logit_scale;
+    float* matrix;      // NULL once quantized
+    char* words;        // NUL-separated block, owned
+    const char** word;  // word[i] points into words
+    int8_t* qmatrix;    // count x dim, NULL when not quantized
+    float* qscale;      // per-row dequantization scale
+    uint16_t* hmatrix;  // count x dim fp16 rows for the re-rank
+    int refs;
+} EmbedIndex;
+
+typedef struct {
+    int index;
+    float prob; // softmax probability over the whole candidate set
+} EmbedMatch;
+
+// Takes ownership of matrix and words
+EmbedIndex* embed_index_create(uint32_t set_id, int count, int dim, float logit_scale,
+                               float* matrix, char* words);
+void embed_index_retain(EmbedIndex* idx);
+void embed_index_release(EmbedIndex* idx);
+
+// Replace the float matrix with the int8 and fp16 rows; create() does
+// this itself for large word banks
+void embed_index_quantize(EmbedIndex* idx);
+// Bytes held for the embeddings (whichever rows the index keeps)
+size_t embed_index_bytes(const EmbedIndex* idx);
+
+int embed_index_find(const EmbedIndex* idx, const char* word);
+
+// Score every word against a normalized image embedding and return the k
+// best matches (descending). If target_index >= 0, *target_prob receives
+// its probability. Returns the number of matches written.
+int embed_index_rank(const EmbedIndex* idx, const float* query, int k, EmbedMatch* out,
+                     int target_index, float* target_prob);
+
+// Word table written by export_onnx.py: this header, words_len bytes of
+// NUL-separated words, then count x dim floats (little-endian)
+#define EMBED_TABLE_MAGIC 0x45544744u // "DGTE"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t dim;
+    float logit_scale;
+    uint32_t words_len;
+} EmbedTableHeader;
+
+// Index of a whole word table; NULL if missing or invalid
+EmbedIndex* embed_index_load(const char* path, uint32_t set_id);
+
+// Memory, speed and recall of the quantized index against the float one, on clustered
+// synthetic embeddings with low margins and on the exported model table at
+// table_path if it exists (server --bench index [TABLE])
+void embed_index_benchmark(const char* table_path);
+
+#endif
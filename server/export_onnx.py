@@ -0,0 +1,60 @@
+# Export the CLIP image encoder and the word bank's text embeddings for the
+# in-process ONNX backend (draw_guess_server --ai-backend onnx, ai_onnx.c).
+# Run from server/ after download_clip.py; re-run when the word bank changes.
+import sqlite3
+import struct
+import sys
+import numpy as np
+import torch
+from transformers import CLIPProcessor, CLIPModel
+
+MODEL_PATH = "./model"
+DB_PATH = "game_data.db"
+IMAGE_ENCODER = MODEL_PATH + "/image_encoder.onnx"
+TEXT_TABLE = MODEL_PATH + "/text_embeddings.bin"
+TEXT_TABLE_MAGIC = 0x45544744  # "DGTE", see EmbedTableHeader in embed_index.h
+TEXT_BATCH = 256
+
+class ImageEncoder(torch.nn.Module):
+    def __init__(self, model):
+        super().__init__()
+        self.model = model
+
+    def forward(self, pixel_values):
+        features = self.model.get_image_features(pixel_values=pixel_values)
+        return features / features.norm(dim=-1, keepdim=True)
+
+def main():
+    db_path = sys.argv[1] if len(sys.argv) > 1 else DB_PATH
+    model = CLIPModel.from_pretrained(MODEL_PATH).eval()
+    processor = CLIPProcessor.from_pretrained(MODEL_PATH)
+
+    dummy = torch.zeros(1, 3, 224, 224)
+    torch.onnx.export(ImageEncoder(model), dummy, IMAGE_ENCODER,
+                      input_names=["pixel_values"], output_names=["image_embeds"],
+                      dynamic_axes={"pixel_values": {0: "batch"}, "image_embeds": {0: "batch"}},
+                      opset_version=17)
+    print(f"Wrote {IMAGE_ENCODER}")
+
+    conn = sqlite3.connect(db_path)
+    words = [row[0] for row in conn.execute("SELECT word FROM words")]
+    conn.close()
+
+    chunks = []
+    with torch.no_grad():
+        for i in range(0, len(words), TEXT_BATCH):
+            inputs = processor.tokenizer(words[i:i + TEXT_BATCH], return_tensors="pt", padding=True)
+            features = model.get_text_features(**inputs)
+            chunks.append(features / features.norm(dim=-1, keepdim=True))
+    matrix = torch.cat(chunks).to(torch.float32).numpy()
+
+    block = b"".join(w.encode("utf-8") + b"\0" for w in words)
+    logit_scale = model.logit_scale.exp().item()
+    with open(TEXT_TABLE, "wb") as f:
+        f.write(struct.pack("<IIIfI", TEXT_TABLE_MAGIC, len(words), matrix.shape[1], logit_scale, len(block)))
+        f.write(block)
+        f.write(np.ascontiguousarray(matrix).tobytes())
+    print(f"Wrote {len(words)} word embeddings to {TEXT_TABLE}")
+
+if __name__ == "__main__":
+    main()
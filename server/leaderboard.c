@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "leaderboard.h"
+
+#define LB_MAX_LEVEL 24
+#define LB_MIN_BUCKETS 256
+
+typedef struct LbNode LbNode;
+
+typedef struct {
+    LbNode* next;
+    uint32_t span; // level-0 steps this link covers
+} LbLink;
+
+struct LbNode {
+    PlayerStats stats;
+    LbNode* hash_next;
+    int level;
+    LbLink link[]; // level entries
+};
+
+static pthread_mutex_t lb_mutex = PTHREAD_MUTEX_INITIALIZER;
+static LbNode* head = NULL; // LB_MAX_LEVEL links, no stats
+static int level = 1;
+static int length = 0;
+static uint32_t rng = 0x2545F491u;
+
+// Name -> node, chained; doubled when the load passes 2
+static LbNode** buckets = NULL;
+static uint32_t num_buckets = 0;
+
+static uint32_t name_hash(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (; *name; name++) {
+        hash ^= (uint8_t)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static LbNode* hash_find(const char* name) {
+    if (!buckets) return NULL;
+    for (LbNode* n = buckets[name_hash(name) & (num_buckets - 1)]; n; n = n->hash_next) {
+        if (strcmp(n->stats.username, name) == 0) return n;
+    }
+    return NULL;
+}
+
+static int hash_insert(LbNode* node) {
+    if (!buckets || (uint32_t)length >= num_buckets * 2) {
+        uint32_t grown = num_buckets ? num_buckets * 2 : LB_MIN_BUCKETS;
+        LbNode** table = calloc(grown, sizeof(LbNode*));
+        if (!table) return -1;
+        for (uint32_t i = 0; i < num_buckets; i++) {
+            for (LbNode* n = buckets[i]; n;) {
+                LbNode* next = n->hash_next;
+                uint32_t b = name_hash(n->stats.username) & (grown - 1);
+                n->hash_next = table[b];
+                table[b] = n;
+                n = next;
+            }
+        }
+        free(buckets);
+        buckets = table;
+        num_buckets = grown;
+    }
+    uint32_t b = name_hash(node->stats.username) & (num_buckets - 1);
+    node->hash_next = buckets[b];
+    buckets[b] = node;
+    return 0;
+}
+
+// < 0 if a ranks above b
+static int compare(const PlayerStats* a, const PlayerStats* b) {
+    if (a->wins != b->wins) return a->wins > b->wins ? -1 : 1;
+    if (a->games != b->games) return a->games < b->games ? -1 : 1;
+    return strcmp(a->username, b->username);
+}
+
+static int random_level(void) {
+    int lvl = 1;
+    // p = 1/4 per extra level
+    for (;;) {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        if ((rng & 3) != 0 || lvl >= LB_MAX_LEVEL) break;
+        lvl++;
+    }
+    return lvl;
+}
+
+static int ensure_head(void) {
+    if (head) return 0;
+    head = calloc(1, sizeof(LbNode) + sizeof(LbLink) * LB_MAX_LEVEL);
+    if (!head) return -1;
+    head->level = LB_MAX_LEVEL;
+    return 0;
+}
+
+static void list_insert(LbNode* node) {
+    LbNode* update[LB_MAX_LEVEL];
+    uint32_t rank[LB_MAX_LEVEL];
+    LbNode* x = head;
+    for (int i = level - 1; i >= 0; i--) {
+        rank[i] = i == level - 1 ? 0 : rank[i + 1];
+        while (x->link[i].next && compare(&x->link[i].next->stats, &node->stats) < 0) {
+            rank[i] += x->link[i].span;
+            x = x->link[i].next;
+        }
+        update[i] = x;
+    }
+    if (node->level > level) {
+        for (int i = level; i < node->level; i++) {
+            rank[i] = 0;
+            update[i] = head;
+            update[i]->link[i].span = (uint32_t)length;
+        }
+        level = node->level;
+    }
+    for (int i = 0; i < node->level; i++) {
+        node->link[i].next = update[i]->link[i].next;
+        update[i]->link[i].next = node;
+        node->link[i].span = update[i]->link[i].span - (rank[0] - rank[i]);
+        update[i]->link[i].span = (rank[0] - rank[i]) + 1;
+    }
+    for (int i = node->level; i < level; i++) update[i]->link[i].span++;
+    length++;
+}
+
+static void list_remove(LbNode* node) {
+    LbNode* update[LB_MAX_LEVEL];
+    LbNode* x = head;
+    for (int i = level - 1; i >= 0; i--) {
+        while (x->link[i].next && compare(&x->link[i].next->stats, &node->stats) < 0) x = x->link[i].next;
+        update[i] = x;
+    }
+    for (int i = 0; i < level; i++) {
+        if (update[i]->link[i].next == node) {
+            update[i]->link[i].span += node->link[i].span - 1;
+            update[i]->link[i].next = node->link[i].next;
+        } else {
+            update[i]->link[i].span--;
+        }
+    }
+    while (level > 1 && !head->link[level - 1].next) level--;
+    length--;
+}
+
+// Caller holds lb_mutex
+static LbNode* node_for(const char* username) {
+    LbNode* node = hash_find(username);
+    if (node) {
+        list_remove(node);
+        return node;
+    }
+    if (ensure_head() != 0) return NULL;
+    int lvl = random_level();
+    node = calloc(1, sizeof(LbNode) + sizeof(LbLink) * lvl);
+    if (!node) return NULL;
+    node->level = lvl;
+    snprintf(node->stats.username, sizeof(node->stats.username), "%s", username);
+    if (hash_insert(node) != 0) {
+        free(node);
+        return NULL;
+    }
+    return node;
+}
+
+void leaderboard_put(const PlayerStats* stats) {
+    pthread_mutex_lock(&lb_mutex);
+    LbNode* node = node_for(stats->username);
+    if (node) {
+        node->stats = *stats;
+        node->stats.username[sizeof(node->stats.username) - 1] = '\0';
+        list_insert(node);
+    }
+    pthread_mutex_unlock(&lb_mutex);
+}
+
+void leaderboard_add(const PlayerStats* delta) {
+    pthread_mutex_lock(&lb_mutex);
+    LbNode* node = node_for(delta->username);
+    if (node) {
+        node->stats.games += delta->games;
+        node->stats.wins += delta->wins;
+        node->stats.guesses += delta->guesses;
+        node->stats.painter_rounds += delta->painter_rounds;
+        node->stats.ai_beaten += delta->ai_beaten;
+        list_insert(node);
+    }
+    pthread_mutex_unlock(&lb_mutex);
+}
+
+int leaderboard_top(int from, int n, PlayerStats* out) {
+    int count = 0;
+    pthread_mutex_lock(&lb_mutex);
+    if (head && from >= 1 && from <= length) {
+        // Descend to rank from, then walk level 0
+        LbNode* x = head;
+        uint32_t traversed = 0;
+        for (int i = level - 1; i >= 0; i--) {
+            while (x->link[i].next && traversed + x->link[i].span <= (uint32_t)from) {
+                traversed += x->link[i].span;
+                x = x->link[i].next;
+            }
+        }
+        for (; x && count < n; x = x->link[0].next) out[count++] = x->stats;
+    }
+    pthread_mutex_unlock(&lb_mutex);
+    return count;
+}
+
+int leaderboard_rank(const char* username, PlayerStats* out) {
+    int rank = 0;
+    pthread_mutex_lock(&lb_mutex);
+    LbNode* node = hash_find(username);
+    if (node) {
+        LbNode* x = head;
+        for (int i = level - 1; i >= 0; i--) {
+            while (x->link[i].next && compare(&x->link[i].next->stats, &node->stats) <= 0) {
+                rank += (int)x->link[i].span;
+                x = x->link[i].next;
+            }
+        }
+        if (out) *out = node->stats;
+    }
+    pthread_mutex_unlock(&lb_mutex);
+    return rank;
+}
+
+int leaderboard_size(void) {
+    pthread_mutex_lock(&lb_mutex);
+    int n = length;
+    pthread_mutex_unlock(&lb_mutex);
+    return n;
+}
+
+void leaderboard_free(void) {
+    pthread_mutex_lock(&lb_mutex);
+    for (LbNode* x = head ? head->link[0].next : NULL; x;) {
+        LbNode* next = x->link[0].next;
+        free(x);
+        x = next;
+    }
+    free(head);
+    free(buckets);
+    head = NULL;
+    buckets = NULL;
+    num_buckets = 0;
+    level = 1;
+    length = 0;
+    pthread_mutex_unlock(&lb_mutex);
+}
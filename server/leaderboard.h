@@ -0,0 +1,33 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <stdint.h>
+
+// Per-player totals, kept in player_stats and mirrored here in an indexable
+// skip list (each link records how many players it skips), so top-N and
+// rank-of-player are O(log n) without touching the history table. Players
+// are ordered by wins, then fewer games, then name. Thread-safe.
+
+typedef struct {
+    char username[32];
+    uint32_t games;
+    uint32_t wins;           // rounds guessed correctly
+    uint32_t guesses;        // rounds a guess was submitted
+    uint32_t painter_rounds;
+    uint32_t ai_beaten;      // correct where the AI's final guess was wrong
+} PlayerStats;
+
+// Set a player's totals (startup load from player_stats)
+void leaderboard_put(const PlayerStats* stats);
+// Add delta to a player's totals, creating the player if needed
+void leaderboard_add(const PlayerStats* delta);
+
+// Copy up to n players starting at 1-based rank from; returns the count
+int leaderboard_top(int from, int n, PlayerStats* out);
+// 1-based rank of username with its totals in out (may be NULL), 0 if unknown
+int leaderboard_rank(const char* username, PlayerStats* out);
+int leaderboard_size(void);
+
+void leaderboard_free(void);
+
+#endif
@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <string.h>
+#include "metrics.h"
+
+static const char* const metric_names[METRIC_COUNT] = {
+    "ai_requests",
+    "ai_cache_hits",
+    "ai_cache_misses",
+    "ai_cache_evictions",
+    "ai_failures",
+    "ai_timeouts",
+    "ai_cancelled",
+    "ai_breaker_opens",
+    "ai_breaker_skips",
+    "ai_not_ready",
+    "ai_sidecar_restarts",
+    "ai_live_skipped",
+    "db_checkpoints",
+    "db_checkpoint_pages",
+    "db_retention_rows",
+    "db_vacuum_pages",
+    "db_writes",
+    "db_write_txns",
+};
+
+static long long counters[METRIC_COUNT];
+static long long logged[METRIC_COUNT];
+
+void metric_add(MetricId id, long long n) {
+    __atomic_fetch_add(&counters[id], n, __ATOMIC_RELAXED);
+}
+
+long long metric_get(MetricId id) {
+    return __atomic_load_n(&counters[id], __ATOMIC_RELAXED);
+}
+
+void metrics_log(void) {
+    long long now[METRIC_COUNT];
+    for (int i = 0; i < METRIC_COUNT; i++) now[i] = metric_get((MetricId)i);
+    if (memcmp(now, logged, sizeof(now)) == 0) return;
+    memcpy(logged, now, sizeof(now));
+
+    char line[1024];
+    int len = snprintf(line, sizeof(line), "Metrics:");
+    for (int i = 0; i < METRIC_COUNT && len < (int)sizeof(line); i++) {
+        len += snprintf(line + len, sizeof(line) - len, " %s=%lld", metric_names[i], now[i]);
+    }
+    long long lookups = now[METRIC_AI_CACHE_HITS] + now[METRIC_AI_CACHE_MISSES];
+    if (lookups > 0 && len < (int)sizeof(line)) {
+        snprintf(line + len, sizeof(line) - len, " ai_cache_hit_rate=%.1f%%",
+                 100.0 * now[METRIC_AI_CACHE_HITS] / lookups);
+    }
+    printf("%s\n", line);
+}
@@ -0,0 +1,36 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+// Process-wide counters, logged periodically by the game timer
+// (metrics_log). Updates are lock-free.
+
+typedef enum {
+    METRIC_AI_REQUESTS,      // image predictions asked for
+    METRIC_AI_CACHE_HITS,
+    METRIC_AI_CACHE_MISSES,
+    METRIC_AI_CACHE_EVICTIONS,
+    METRIC_AI_FAILURES,      // backend calls that failed before their deadline
+    METRIC_AI_TIMEOUTS,      // backend calls or queued requests past their deadline
+    METRIC_AI_CANCELLED,     // requests dropped because the round ended
+    METRIC_AI_BREAKER_OPENS,
+    METRIC_AI_BREAKER_SKIPS, // requests not sent while the breaker was open
+    METRIC_AI_NOT_READY,     // requests skipped while the backend was starting
+    METRIC_AI_SIDECAR_RESTARTS,
+    METRIC_AI_LIVE_SKIPPED,  // live predictions shed by the room budget or the global cap
+    METRIC_DB_CHECKPOINTS,
+    METRIC_DB_CHECKPOINT_PAGES,
+    METRIC_DB_RETENTION_ROWS,  // drawings and history rows past their retention
+    METRIC_DB_VACUUM_PAGES,    // pages returned by incremental vacuum
+    METRIC_DB_WRITES,          // jobs applied by the writer
+    METRIC_DB_WRITE_TXNS,      // transactions they were grouped into
+    METRIC_COUNT
+} MetricId;
+
+void metric_add(MetricId id, long long n);
+static inline void metric_inc(MetricId id) { metric_add(id, 1); }
+long long metric_get(MetricId id);
+
+// Print every counter on one line if anything changed since the last call
+void metrics_log(void);
+
+#endif
@@ -27,7 +27,14 @@ typedef enum {
     MSG_ROOM_JOINED = 19,
     MSG_ROOM_LEFT = 20,
     MSG_AI_GUESS_REQ = 21,
-    MSG_AI_GUESS_RESULT = 22
+    MSG_AI_GUESS_RESULT = 22,
+    MSG_AI_LIVE_GUESS = 23,
+    MSG_HISTORY_PAGE = 24,
+    MSG_LEADERBOARD_REQ = 25,
+    MSG_LEADERBOARD = 26,
+    MSG_REPLAY_REQ = 27,
+    MSG_REPLAY_DATA = 28,
+    MSG_REPLAY_END = 29
 } MessageType;
 
 typedef enum {
@@ -78,8 +85,15 @@ typedef struct {
     uint8_t guess_count;
 } GameEndMessage;
 
+#define HISTORY_PAGE_ROWS 50
+
+// Keyset pagination: each page is the rows older than before_record_id.
+// A request without these fields (data_len 0) gets the newest page as
+// MSG_HISTORY_DATA messages and MSG_HISTORY_END.
 typedef struct {
     BaseMessage base;
+    int32_t before_record_id; // 0 = newest page
+    uint8_t page_size;        // 1..HISTORY_PAGE_ROWS, 0 = HISTORY_PAGE_ROWS
 } HistoryRequestMessage;
 
 typedef struct {
@@ -90,6 +104,89 @@ typedef struct {
     char game_time[32];
 } HistoryDataMessage;
 
+typedef struct {
+    int32_t record_id;
+    int32_t game_id;
+    char word[32];
+    char user_guess[64];
+    char game_time[32];
+} HistoryRow;
+
+// One page in one frame; data_len covers only the first count rows
+typedef struct {
+    BaseMessage base;
+    uint8_t count;
+    uint8_t more;        // older rows exist
+    int32_t next_before; // cursor for the next page
+    HistoryRow rows[HISTORY_PAGE_ROWS];
+} HistoryPageMessage;
+
+#define LEADERBOARD_MAX_ROWS 20
+
+typedef struct {
+    BaseMessage base;
+    uint8_t count;     // top-N, 0 = 10, at most LEADERBOARD_MAX_ROWS
+    char username[32]; // player whose rank is reported, "" = the requester
+} LeaderboardRequestMessage;
+
+typedef struct {
+    char username[32];
+    uint32_t rank; // 1-based, 0 = no games yet
+    uint32_t games;
+    uint32_t wins;
+    uint32_t guesses;
+    uint32_t painter_rounds;
+    uint32_t ai_beaten;
+} LeaderboardEntry;
+
+// data_len covers only the first count entries
+typedef struct {
+    BaseMessage base;
+    uint32_t total_players;
+    LeaderboardEntry player;
+    uint8_t count;
+    LeaderboardEntry entries[LEADERBOARD_MAX_ROWS];
+} LeaderboardMessage;
+
+#define REPLAY_MAX_SPEED 16
+#define REPLAY_BATCH_POINTS 64
+
+typedef struct {
+    BaseMessage base;
+    int32_t game_id;
+    uint8_t speed; // 0 = instant, N = N times real time (at most REPLAY_MAX_SPEED)
+} ReplayRequestMessage;
+
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint8_t action;
+    uint8_t color_r;
+    uint8_t color_g;
+    uint8_t color_b;
+} ReplayPoint;
+
+// Points due since the last frame; data_len covers only the first count
+typedef struct {
+    BaseMessage base;
+    int32_t game_id;
+    uint8_t count;
+    ReplayPoint points[REPLAY_BATCH_POINTS];
+} ReplayDataMessage;
+
+typedef enum {
+    REPLAY_DONE = 0,
+    REPLAY_NOT_FOUND = 1,
+    REPLAY_BUSY = 2,
+    REPLAY_FAILED = 3
+} ReplayStatus;
+
+typedef struct {
+    BaseMessage base;
+    int32_t game_id;
+    uint8_t status; // ReplayStatus
+} ReplayEndMessage;
+
 // New structs
 typedef struct {
     BaseMessage base;
@@ -111,6 +208,8 @@ typedef struct {
     BaseMessage base;
     char room_name[32];
     char nickname[32];
+    char category[16];  // word filter, "" = any
+    uint8_t difficulty; // 1-3, 0 = any
 } CreateRoomMessage;
 
 typedef struct {
@@ -156,4 +255,12 @@ typedef struct {
     uint8_t is_correct;
 } AiGuessResultMessage;
 
+// Current top guesses of the AI while the painter is still drawing
+typedef struct {
+    BaseMessage base;
+    uint8_t num_guesses;
+    char words[3][32];
+    uint8_t scores[3]; // percent
+} AiLiveGuessMessage;
+
 #endif
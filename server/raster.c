@@ -0,0 +1,157 @@
+#include <string.h>
+#include <math.h>
+#include "raster.h"
+#include "raster_kernels.h"
+
+// Canvas -> raster mapping: scale the short side to RASTER_SIZE, then crop
+// the long side around the center (matches CLIPProcessor resize + crop).
+#define RASTER_SCALE ((float)RASTER_SIZE / (float)(CANVAS_WIDTH < CANVAS_HEIGHT ? CANVAS_WIDTH : CANVAS_HEIGHT))
+#define RASTER_OFFSET_X ((CANVAS_WIDTH * RASTER_SCALE - RASTER_SIZE) * 0.5f)
+#define RASTER_OFFSET_Y ((CANVAS_HEIGHT * RASTER_SCALE - RASTER_SIZE) * 0.5f)
+
+// Destination planes of either pixel format
+typedef struct {
+    uint8_t* u8[3];
+    float* f32[3];
+} PlaneSet;
+
+// Draw a round-capped segment of the given radius. Each row only visits
+// the pixels the capsule can touch, then blends the coverage row into the
+// three colour planes.
+static void draw_segment(const PlaneSet* dst, float x0, float y0, float x1, float y1,
+                         float radius, const uint8_t color[3]) {
+    const RasterKernels* k = raster_kernels();
+    RasterSegment seg;
+    seg.x0 = x0;
+    seg.y0 = y0;
+    seg.dx = x1 - x0;
+    seg.dy = y1 - y0;
+    float len_sq = seg.dx * seg.dx + seg.dy * seg.dy;
+    seg.inv_len_sq = len_sq > 0.0f ? 1.0f / len_sq : 0.0f;
+    seg.reach = radius + 0.5f;
+
+    int min_y = (int)floorf((y0 < y1 ? y0 : y1) - seg.reach);
+    int max_y = (int)ceilf((y0 > y1 ? y0 : y1) + seg.reach);
+    if (min_y < 0) min_y = 0;
+    if (max_y > RASTER_SIZE - 1) max_y = RASTER_SIZE - 1;
+
+    float cov[RASTER_SIZE];
+    for (int py = min_y; py <= max_y; py++) {
+        // Any pixel within reach of the segment is within reach of a point
+        // whose y lies in [cy - reach, cy + reach]
+        float cy = (float)py + 0.5f;
+        float t_lo = 0.0f, t_hi = 1.0f;
+        if (seg.dy != 0.0f) {
+            float ta = (cy - seg.reach - y0) / seg.dy;
+            float tb = (cy + seg.reach - y0) / seg.dy;
+            t_lo = ta < tb ? ta : tb;
+            t_hi = ta < tb ? tb : ta;
+            if (t_lo < 0.0f) t_lo = 0.0f;
+            if (t_hi > 1.0f) t_hi = 1.0f;
+            if (t_lo > t_hi) continue;
+        }
+        float xa = x0 + t_lo * seg.dx;
+        float xb = x0 + t_hi * seg.dx;
+        int min_x = (int)floorf((xa < xb ? xa : xb) - seg.reach);
+        int max_x = (int)ceilf((xa > xb ? xa : xb) + seg.reach);
+        if (min_x < 0) min_x = 0;
+        if (max_x > RASTER_SIZE - 1) max_x = RASTER_SIZE - 1;
+        int n = max_x - min_x + 1;
+        if (n <= 0) continue;
+
+        k->coverage_row(cov, &seg, min_x, py, n);
+        int idx = py * RASTER_SIZE + min_x;
+        for (int c = 0; c < 3; c++) {
+            if (dst->u8[c]) {
+                k->blend_u8(dst->u8[c] + idx, cov, n, color[c]);
+            } else {
+                k->blend_f32(dst->f32[c] + idx, cov, n, color[c] / 255.0f);
+            }
+        }
+    }
+}
+
+static void pen_apply(RasterPen* pen, const PlaneSet* dst, uint16_t x, uint16_t y, uint8_t action,
+                      const uint8_t color[3]) {
+    const float radius = RASTER_BRUSH_WIDTH * 0.5f * RASTER_SCALE;
+    float fx = x * RASTER_SCALE - RASTER_OFFSET_X;
+    float fy = y * RASTER_SCALE - RASTER_OFFSET_Y;
+
+    if (action == 1) { // Press
+        draw_segment(dst, fx, fy, fx, fy, radius, color);
+    } else if (action == 2) { // Move
+        if (pen->has_last) {
+            draw_segment(dst, pen->last_x, pen->last_y, fx, fy, radius, color);
+        }
+    } else {
+        return;
+    }
+    pen->last_x = fx;
+    pen->last_y = fy;
+    pen->has_last = 1;
+}
+
+void raster_clear(Raster* r) {
+    memset(r->planes, 255, sizeof(r->planes));
+    r->pen.has_last = 0;
+}
+
+void raster_apply(Raster* r, uint16_t x, uint16_t y, uint8_t action,
+                  uint8_t color_r, uint8_t color_g, uint8_t color_b) {
+    if (action == 3) { // Clear
+        raster_clear(r);
+        return;
+    }
+    const uint8_t color[3] = { color_r, color_g, color_b };
+    PlaneSet dst = { { r->planes[0], r->planes[1], r->planes[2] }, { NULL, NULL, NULL } };
+    pen_apply(&r->pen, &dst, x, y, action, color);
+}
+
+void raster_hash(const Raster* r, RasterHash* out) {
+    enum { BLOCK = RASTER_SIZE / RASTER_HASH_GRID };
+    uint32_t sums[RASTER_HASH_GRID * RASTER_HASH_GRID];
+    uint64_t total = 0;
+    for (int by = 0; by < RASTER_HASH_GRID; by++) {
+        for (int bx = 0; bx < RASTER_HASH_GRID; bx++) {
+            uint32_t sum = 0;
+            for (int y = by * BLOCK; y < (by + 1) * BLOCK; y++) {
+                int row = y * RASTER_SIZE + bx * BLOCK;
+                for (int x = 0; x < BLOCK; x++) {
+                    sum += r->planes[0][row + x] + r->planes[1][row + x] + r->planes[2][row + x];
+                }
+            }
+            sums[by * RASTER_HASH_GRID + bx] = sum;
+            total += sum;
+        }
+    }
+    
+    memset(out, 0, sizeof(*out));
+    uint64_t blocks = RASTER_HASH_GRID * RASTER_HASH_GRID;
+    for (int i = 0; i < RASTER_HASH_GRID * RASTER_HASH_GRID; i++) {
+        if ((uint64_t)sums[i] * blocks < total) out->bits[i / 64] |= 1ull << (i % 64);
+    }
+}
+
+int raster_hash_distance(const RasterHash* a, const RasterHash* b) {
+    int d = 0;
+    for (int i = 0; i < RASTER_HASH_WORDS; i++) d += __builtin_popcountll(a->bits[i] ^ b->bits[i]);
+    return d;
+}
+
+void raster_f32_clear(RasterF32* r) {
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < RASTER_PIXELS; i++) r->planes[c][i] = 1.0f;
+    }
+    r->pen.has_last = 0;
+}
+
+void raster_f32_apply(RasterF32* r, uint16_t x, uint16_t y, uint8_t action,
+                      uint8_t color_r, uint8_t color_g, uint8_t color_b) {
+    if (action == 3) { // Clear
+        raster_f32_clear(r);
+        return;
+    }
+    const uint8_t color[3] = { color_r, color_g, color_b };
+    PlaneSet dst = { { NULL, NULL, NULL }, { r->planes[0], r->planes[1], r->planes[2] } };
+    pen_apply(&r->pen, &dst, x, y, action, color);
+}
@@ -0,0 +1,57 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdint.h>
+
+// Server-side stroke rasterizer. Strokes arrive in client canvas space
+// (CANVAS_WIDTH x CANVAS_HEIGHT) and are drawn straight into a
+// RASTER_SIZE x RASTER_SIZE planar RGB image, using the same
+// shortest-side resize + center crop as the CLIP image processor.
+
+#define CANVAS_WIDTH 800
+#define CANVAS_HEIGHT 600
+#define RASTER_SIZE 224
+#define RASTER_PIXELS (RASTER_SIZE * RASTER_SIZE)
+#define RASTER_BRUSH_WIDTH 3.0f // client pen width, in canvas pixels
+
+typedef struct {
+    float last_x;
+    float last_y;
+    int has_last;
+} RasterPen;
+
+typedef struct {
+    uint8_t planes[3][RASTER_PIXELS]; // R, G, B
+    RasterPen pen;
+} Raster;
+
+// Same image with float planes in [0, 1], for backends that take floats
+typedef struct {
+    float planes[3][RASTER_PIXELS];
+    RasterPen pen;
+} RasterF32;
+
+void raster_clear(Raster* r);
+
+// Apply one paint event (action: 1=Press, 2=Move, 3=Clear)
+void raster_apply(Raster* r, uint16_t x, uint16_t y, uint8_t action,
+                  uint8_t color_r, uint8_t color_g, uint8_t color_b);
+
+// Perceptual hash: one bit per RASTER_HASH_GRID x RASTER_HASH_GRID block,
+// set when the block is darker than the average block. Near-identical
+// drawings land a few bits apart (raster_hash_distance).
+#define RASTER_HASH_GRID 16
+#define RASTER_HASH_WORDS (RASTER_HASH_GRID * RASTER_HASH_GRID / 64)
+
+typedef struct {
+    uint64_t bits[RASTER_HASH_WORDS];
+} RasterHash;
+
+void raster_hash(const Raster* r, RasterHash* out);
+int raster_hash_distance(const RasterHash* a, const RasterHash* b);
+
+void raster_f32_clear(RasterF32* r);
+void raster_f32_apply(RasterF32* r, uint16_t x, uint16_t y, uint8_t action,
+                      uint8_t color_r, uint8_t color_g, uint8_t color_b);
+
+#endif
@@ -0,0 +1,380 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "raster_kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RASTER_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+// ---- Scalar ----
+
+static void coverage_row_scalar(float* cov, const RasterSegment* s, int px0, int py, int n) {
+    float cy = (float)py + 0.5f - s->y0;
+    for (int i = 0; i < n; i++) {
+        float cx = (float)(px0 + i) + 0.5f - s->x0;
+        float t = (cx * s->dx + cy * s->dy) * s->inv_len_sq;
+        if (t < 0.0f) t = 0.0f;
+        if (t > 1.0f) t = 1.0f;
+        float ex = cx - t * s->dx;
+        float ey = cy - t * s->dy;
+        float c = s->reach - sqrtf(ex * ex + ey * ey);
+        if (c < 0.0f) c = 0.0f;
+        if (c > 1.0f) c = 1.0f;
+        cov[i] = c;
+    }
+}
+
+static void blend_u8_scalar(uint8_t* dst, const float* cov, int n, uint8_t value) {
+    float target = (float)value;
+    for (int i = 0; i < n; i++) {
+        float v = (float)dst[i];
+        dst[i] = (uint8_t)(v + (target - v) * cov[i] + 0.5f);
+    }
+}
+
+static void blend_f32_scalar(float* dst, const float* cov, int n, float value) {
+    for (int i = 0; i < n; i++) {
+        dst[i] = dst[i] + (value - dst[i]) * cov[i];
+    }
+}
+
+static const RasterKernels kernels_scalar = {
+    "scalar", coverage_row_scalar, blend_u8_scalar, blend_f32_scalar
+};
+
+#ifdef RASTER_HAVE_X86
+
+// ---- SSE4.1 ----
+// Same operation order as the scalar path and no FMA, so results match
+// bit for bit.
+
+__attribute__((target("sse4.1")))
+static void coverage_row_sse4(float* cov, const RasterSegment* s, int px0, int py, int n) {
+    const __m128 dx = _mm_set1_ps(s->dx);
+    const __m128 dy = _mm_set1_ps(s->dy);
+    const __m128 inv = _mm_set1_ps(s->inv_len_sq);
+    const __m128 reach = _mm_set1_ps(s->reach);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 cy = _mm_set1_ps((float)py + 0.5f - s->y0);
+    const __m128 cydy = _mm_mul_ps(cy, dy);
+    const __m128 step = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 px = _mm_add_ps(_mm_set1_ps((float)(px0 + i)), step);
+        __m128 cx = _mm_sub_ps(_mm_add_ps(px, _mm_set1_ps(0.5f)), _mm_set1_ps(s->x0));
+        __m128 t = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(cx, dx), cydy), inv);
+        t = _mm_min_ps(_mm_max_ps(t, zero), one);
+        __m128 ex = _mm_sub_ps(cx, _mm_mul_ps(t, dx));
+        __m128 ey = _mm_sub_ps(cy, _mm_mul_ps(t, dy));
+        __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)));
+        __m128 c = _mm_min_ps(_mm_max_ps(_mm_sub_ps(reach, d), zero), one);
+        _mm_storeu_ps(cov + i, c);
+    }
+    if (i < n) coverage_row_scalar(cov + i, s, px0 + i, py, n - i);
+}
+
+__attribute__((target("sse4.1")))
+static void blend_u8_sse4(uint8_t* dst, const float* cov, int n, uint8_t value) {
+    const __m128 target = _mm_set1_ps((float)value);
+    const __m128 half = _mm_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int32_t packed;
+        memcpy(&packed, dst + i, 4);
+        __m128 v = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed)));
+        __m128 r = _mm_add_ps(_mm_add_ps(v, _mm_mul_ps(_mm_sub_ps(target, v), _mm_loadu_ps(cov + i))), half);
+        __m128i q = _mm_cvttps_epi32(r);
+        q = _mm_packus_epi32(q, q);
+        q = _mm_packus_epi16(q, q);
+        packed = _mm_cvtsi128_si32(q);
+        memcpy(dst + i, &packed, 4);
+    }
+    if (i < n) blend_u8_scalar(dst + i, cov + i, n - i, value);
+}
+
+__attribute__((target("sse4.1")))
+static void blend_f32_sse4(float* dst, const float* cov, int n, float value) {
+    const __m128 target = _mm_set1_ps(value);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(dst + i);
+        _mm_storeu_ps(dst + i, _mm_add_ps(v, _mm_mul_ps(_mm_sub_ps(target, v), _mm_loadu_ps(cov + i))));
+    }
+    if (i < n) blend_f32_scalar(dst + i, cov + i, n - i, value);
+}
+
+static const RasterKernels kernels_sse4 = {
+    "sse4.1", coverage_row_sse4, blend_u8_sse4, blend_f32_sse4
+};
+
+// ---- AVX2 ----
+
+__attribute__((target("avx2")))
+static void coverage_row_avx2(float* cov, const RasterSegment* s, int px0, int py, int n) {
+    const __m256 dx = _mm256_set1_ps(s->dx);
+    const __m256 dy = _mm256_set1_ps(s->dy);
+    const __m256 inv = _mm256_set1_ps(s->inv_len_sq);
+    const __m256 reach = _mm256_set1_ps(s->reach);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 cy = _mm256_set1_ps((float)py + 0.5f - s->y0);
+    const __m256 cydy = _mm256_mul_ps(cy, dy);
+    const __m256 step = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 px = _mm256_add_ps(_mm256_set1_ps((float)(px0 + i)), step);
+        __m256 cx = _mm256_sub_ps(_mm256_add_ps(px, _mm256_set1_ps(0.5f)), _mm256_set1_ps(s->x0));
+        __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(cx, dx), cydy), inv);
+        t = _mm256_min_ps(_mm256_max_ps(t, zero), one);
+        __m256 ex = _mm256_sub_ps(cx, _mm256_mul_ps(t, dx));
+        __m256 ey = _mm256_sub_ps(cy, _mm256_mul_ps(t, dy));
+        __m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey)));
+        __m256 c = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(reach, d), zero), one);
+        _mm256_storeu_ps(cov + i, c);
+    }
+    if (i < n) coverage_row_scalar(cov + i, s, px0 + i, py, n - i);
+}
+
+__attribute__((target("avx2")))
+static void blend_u8_avx2(uint8_t* dst, const float* cov, int n, uint8_t value) {
+    const __m256 target = _mm256_set1_ps((float)value);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(dst + i))));
+        __m256 r = _mm256_add_ps(_mm256_add_ps(v, _mm256_mul_ps(_mm256_sub_ps(target, v), _mm256_loadu_ps(cov + i))), half);
+        __m256i q = _mm256_cvttps_epi32(r);
+        __m128i q16 = _mm_packus_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+        _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(q16, q16));
+    }
+    if (i < n) blend_u8_scalar(dst + i, cov + i, n - i, value);
+}
+
+__attribute__((target("avx2")))
+static void blend_f32_avx2(float* dst, const float* cov, int n, float value) {
+    const __m256 target = _mm256_set1_ps(value);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(dst + i);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(v, _mm256_mul_ps(_mm256_sub_ps(target, v), _mm256_loadu_ps(cov + i))));
+    }
+    if (i < n) blend_f32_scalar(dst + i, cov + i, n - i, value);
+}
+
+static const RasterKernels kernels_avx2 = {
+    "avx2", coverage_row_avx2, blend_u8_avx2, blend_f32_avx2
+};
+
+#endif // RASTER_HAVE_X86
+
+// ---- Golden check and dispatch ----
+
+#define CHECK_SIZE 96
+
+// Render a fixed set of strokes (short, long, diagonal, stamps, off-edge)
+// with one kernel set into an 8-bit and a float plane.
+static void render_check_pattern(const RasterKernels* k, uint8_t* u8, float* f32) {
+    float cov[CHECK_SIZE];
+    memset(u8, 255, CHECK_SIZE * CHECK_SIZE);
+    for (int i = 0; i < CHECK_SIZE * CHECK_SIZE; i++) f32[i] = 1.0f;
+
+    for (int s = 0; s < 48; s++) {
+        float x0 = (float)((s * 37) % 110) - 7.0f;
+        float y0 = (float)((s * 53) % 104) - 4.0f;
+        float x1 = (s % 5 == 0) ? x0 : x0 + (float)((s * 11) % 29) - 14.0f;
+        float y1 = (s % 5 == 0) ? y0 : y0 + (float)((s * 17) % 23) - 11.0f;
+        float radius = 0.3f + (float)(s % 7) * 0.45f;
+        RasterSegment seg;
+        seg.x0 = x0;
+        seg.y0 = y0;
+        seg.dx = x1 - x0;
+        seg.dy = y1 - y0;
+        float len_sq = seg.dx * seg.dx + seg.dy * seg.dy;
+        seg.inv_len_sq = len_sq > 0.0f ? 1.0f / len_sq : 0.0f;
+        seg.reach = radius + 0.5f;
+        uint8_t value = (uint8_t)((s * 71) & 0xff);
+        for (int py = 0; py < CHECK_SIZE; py++) {
+            int px0 = (s * 3) % 13;
+            int n = CHECK_SIZE - px0;
+            k->coverage_row(cov, &seg, px0, py, n);
+            k->blend_u8(u8 + py * CHECK_SIZE + px0, cov, n, value);
+            k->blend_f32(f32 + py * CHECK_SIZE + px0, cov, n, value / 255.0f);
+        }
+    }
+}
+
+// Strokes at the edges of what the rasterizer feeds the kernels, rendered
+// with the row/column clipping raster.c applies
+typedef struct {
+    int group;
+    float x0, y0, x1, y1;
+    float radius;
+} EdgeStroke;
+
+enum { EDGE_BORDER, EDGE_ZERO_LENGTH, EDGE_MAX_WIDTH, EDGE_GROUPS };
+static const char* const edge_group_names[EDGE_GROUPS] = { "border", "zero-length", "max-width" };
+
+#define BRUSH_RADIUS 0.56f // RASTER_BRUSH_WIDTH / 2 in raster pixels
+
+static const EdgeStroke edge_strokes[] = {
+    { EDGE_BORDER, -20.0f, 10.0f, 30.0f, 12.0f, 1.5f },              // enters from the left
+    { EDGE_BORDER, 80.0f, 40.0f, 130.0f, 45.0f, 1.5f },              // leaves on the right
+    { EDGE_BORDER, 40.0f, -8.0f, 44.0f, 20.0f, BRUSH_RADIUS },       // top
+    { EDGE_BORDER, 10.0f, 90.0f, 12.0f, 130.0f, 2.0f },              // bottom
+    { EDGE_BORDER, -5.0f, -5.0f, 101.0f, 101.0f, 1.0f },             // corner to corner
+    { EDGE_BORDER, 95.7f, 3.0f, 95.7f, 90.0f, BRUSH_RADIUS },        // along the last column
+    { EDGE_BORDER, 3.0f, 0.2f, 90.0f, 0.2f, BRUSH_RADIUS },          // along the first row
+    { EDGE_BORDER, -30.0f, -30.0f, -10.0f, -2.0f, 3.0f },            // entirely outside
+    { EDGE_ZERO_LENGTH, 48.0f, 48.0f, 48.0f, 48.0f, BRUSH_RADIUS },
+    { EDGE_ZERO_LENGTH, 20.5f, 61.25f, 20.5f, 61.25f, 2.5f },
+    { EDGE_ZERO_LENGTH, 0.0f, 0.0f, 0.0f, 0.0f, 1.5f },              // on the corner
+    { EDGE_ZERO_LENGTH, 95.9f, 47.0f, 95.9f, 47.0f, BRUSH_RADIUS },  // on the right edge
+    { EDGE_MAX_WIDTH, 10.0f, 20.0f, 80.0f, 70.0f, (float)CHECK_SIZE }, // wider than the plane
+    { EDGE_MAX_WIDTH, 48.0f, 48.0f, 48.0f, 48.0f, (float)CHECK_SIZE },
+    { EDGE_MAX_WIDTH, -40.0f, 48.0f, 140.0f, 48.0f, CHECK_SIZE / 3.0f },
+};
+
+static void render_edge_group(const RasterKernels* k, int group, uint8_t* u8, float* f32) {
+    float cov[CHECK_SIZE];
+    memset(u8, 255, CHECK_SIZE * CHECK_SIZE);
+    for (int i = 0; i < CHECK_SIZE * CHECK_SIZE; i++) f32[i] = 1.0f;
+
+    for (size_t s = 0; s < sizeof(edge_strokes) / sizeof(edge_strokes[0]); s++) {
+        const EdgeStroke* e = &edge_strokes[s];
+        if (e->group != group) continue;
+        RasterSegment seg;
+        seg.x0 = e->x0;
+        seg.y0 = e->y0;
+        seg.dx = e->x1 - e->x0;
+        seg.dy = e->y1 - e->y0;
+        float len_sq = seg.dx * seg.dx + seg.dy * seg.dy;
+        seg.inv_len_sq = len_sq > 0.0f ? 1.0f / len_sq : 0.0f;
+        seg.reach = e->radius + 0.5f;
+        int min_x = (int)floorf(fminf(e->x0, e->x1) - seg.reach);
+        int max_x = (int)ceilf(fmaxf(e->x0, e->x1) + seg.reach);
+        int min_y = (int)floorf(fminf(e->y0, e->y1) - seg.reach);
+        int max_y = (int)ceilf(fmaxf(e->y0, e->y1) + seg.reach);
+        if (min_x < 0) min_x = 0;
+        if (min_y < 0) min_y = 0;
+        if (max_x > CHECK_SIZE) max_x = CHECK_SIZE;
+        if (max_y > CHECK_SIZE) max_y = CHECK_SIZE;
+        uint8_t value = (uint8_t)((s * 71 + 13) & 0xff);
+        for (int py = min_y; py < max_y && min_x < max_x; py++) {
+            int n = max_x - min_x;
+            k->coverage_row(cov, &seg, min_x, py, n);
+            k->blend_u8(u8 + py * CHECK_SIZE + min_x, cov, n, value);
+            k->blend_f32(f32 + py * CHECK_SIZE + min_x, cov, n, value / 255.0f);
+        }
+    }
+}
+
+typedef struct {
+    uint8_t ref_u8[CHECK_SIZE * CHECK_SIZE], got_u8[CHECK_SIZE * CHECK_SIZE];
+    float ref_f32[CHECK_SIZE * CHECK_SIZE], got_f32[CHECK_SIZE * CHECK_SIZE];
+} CheckPlanes;
+
+static int planes_match(const CheckPlanes* p) {
+    for (int i = 0; i < CHECK_SIZE * CHECK_SIZE; i++) {
+        if (abs((int)p->ref_u8[i] - (int)p->got_u8[i]) > 1) return 0;
+        if (fabsf(p->ref_f32[i] - p->got_f32[i]) > 1e-4f) return 0;
+    }
+    return 1;
+}
+
+// 1 if k renders every stroke group like the scalar kernels; a failed
+// allocation counts as a mismatch. groups_ok gets one flag per edge group.
+static int matches_scalar_groups(const RasterKernels* k, int* groups_ok) {
+    CheckPlanes* p = malloc(sizeof(CheckPlanes)); // per call, never shared between threads
+    if (!p) return 0;
+    render_check_pattern(&kernels_scalar, p->ref_u8, p->ref_f32);
+    render_check_pattern(k, p->got_u8, p->got_f32);
+    int ok = planes_match(p);
+    for (int g = 0; g < EDGE_GROUPS; g++) {
+        render_edge_group(&kernels_scalar, g, p->ref_u8, p->ref_f32);
+        render_edge_group(k, g, p->got_u8, p->got_f32);
+        int group_ok = planes_match(p);
+        if (groups_ok) groups_ok[g] = group_ok;
+        ok &= group_ok;
+    }
+    free(p);
+    return ok;
+}
+
+static int matches_scalar(const RasterKernels* k) {
+    return matches_scalar_groups(k, NULL);
+}
+
+static const RasterKernels* select_kernels(void) {
+#ifdef RASTER_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && matches_scalar(&kernels_avx2)) {
+        return &kernels_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1") && matches_scalar(&kernels_sse4)) {
+        return &kernels_sse4;
+    }
+#endif
+    return &kernels_scalar;
+}
+
+static const RasterKernels* active_kernels = NULL;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void choose_kernels(void) {
+    active_kernels = select_kernels();
+    printf("Raster kernels: %s\n", active_kernels->name);
+}
+
+const RasterKernels* raster_kernels(void) {
+    pthread_once(&kernels_once, choose_kernels);
+    return active_kernels;
+}
+
+const RasterKernels* raster_kernels_scalar(void) {
+    return &kernels_scalar;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void benchmark_one(const RasterKernels* k) {
+    static uint8_t u8[CHECK_SIZE * CHECK_SIZE];
+    static float f32[CHECK_SIZE * CHECK_SIZE];
+    const int iterations = 300;
+    double start = now_seconds();
+    for (int i = 0; i < iterations; i++) {
+        render_check_pattern(k, u8, f32);
+    }
+    double elapsed = now_seconds() - start;
+    double pixels = (double)iterations * 48 * CHECK_SIZE * (CHECK_SIZE - 6);
+    int groups_ok[EDGE_GROUPS];
+    int ok = matches_scalar_groups(k, groups_ok);
+    printf("  %-8s %8.2f ms  %8.1f Mpixel/s  golden=%s", k->name, elapsed * 1000.0,
+           pixels / elapsed / 1e6, ok ? "ok" : "MISMATCH");
+    for (int g = 0; g < EDGE_GROUPS; g++) {
+        printf("  %s=%s", edge_group_names[g], groups_ok[g] ? "ok" : "MISMATCH");
+    }
+    printf("\n");
+}
+
+void raster_kernels_benchmark(void) {
+    printf("Raster kernels benchmark (48 strokes on a %dx%d plane, u8 + f32;"
+           " golden checks against scalar, including border-clipped, zero-length and max-width strokes):\n",
+           CHECK_SIZE, CHECK_SIZE);
+    benchmark_one(&kernels_scalar);
+#ifdef RASTER_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) benchmark_one(&kernels_sse4);
+    if (__builtin_cpu_supports("avx2")) benchmark_one(&kernels_avx2);
+#endif
+    printf("  selected: %s\n", raster_kernels()->name);
+}
@@ -0,0 +1,36 @@
+#ifndef RASTER_KERNELS_H
+#define RASTER_KERNELS_H
+
+#include <stdint.h>
+
+// Per-row kernels used by the rasterizer. A stroke segment is a capsule
+// (segment + radius); coverage is 1 inside and falls off over one pixel.
+typedef struct {
+    float x0;
+    float y0;
+    float dx;
+    float dy;
+    float inv_len_sq; // 0 for a single-point stamp
+    float reach;      // radius + 0.5
+} RasterSegment;
+
+typedef struct {
+    const char* name;
+    // Coverage of pixels (px0 .. px0+n-1, py) by the segment into cov[0..n-1]
+    void (*coverage_row)(float* cov, const RasterSegment* seg, int px0, int py, int n);
+    // dst[i] += (value - dst[i]) * cov[i]
+    void (*blend_u8)(uint8_t* dst, const float* cov, int n, uint8_t value);
+    void (*blend_f32)(float* dst, const float* cov, int n, float value);
+} RasterKernels;
+
+// Best kernel set for this CPU (AVX2, SSE4.1 or scalar), chosen once on
+// first use (pthread_once) and verified against the scalar path, including
+// border-clipped, zero-length and max-width strokes.
+const RasterKernels* raster_kernels(void);
+const RasterKernels* raster_kernels_scalar(void);
+
+// Time every kernel set available on this CPU and report its golden check
+// per stroke group (server --bench raster)
+void raster_kernels_benchmark(void);
+
+#endif
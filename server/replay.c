@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "sqlite3.h"
+#include "protocol.h"
+#include "drawing_store.h"
+#include "replay.h"
+
+// owner: REPLAY_FREE, REPLAY_CANCELLED or client_id + 1. A request claims
+// a free slot under replay_mutex, fills it in and publishes the owner; a
+// cancel only flips the owner to REPLAY_CANCELLED. Everything else in a
+// claimed slot belongs to the scheduler, which frees it when done.
+enum { REPLAY_FREE = 0, REPLAY_CANCELLED = -1 };
+
+typedef struct {
+    int owner;
+    int client_id;
+    unsigned conn;
+    int game_id;
+    int speed;
+    long long start_ms;
+    long long stalled_ms; // when sends started failing, 0 while they go out
+    sqlite3_int64 offset; // next blob byte to read
+    sqlite3_int64 size;
+    uint8_t buf[REPLAY_READ_CHUNK];
+    size_t buf_len;
+    DrawingDecoder dec;
+    StrokePoint next; // decoded, not yet due
+    int has_next;
+    int finished;     // blob fully decoded
+    ReplayDataMessage frame;
+    int frame_ready;  // built but not sent yet
+    ReplayEndMessage end;
+    int end_ready;    // queued after the last frame
+    int done;
+} Replay;
+
+static pthread_mutex_t replay_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t replay_added = PTHREAD_COND_INITIALIZER;
+static int replay_pending = 0; // a request came in since the last pass
+static Replay replays[REPLAY_MAX_ACTIVE];
+static sqlite3* conn = NULL;
+static sqlite3_stmt* info_stmt = NULL;
+static ReplaySendFn replay_send = NULL;
+
+static long long mono_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Queue REPLAY_END behind any pending frame
+static void queue_end(Replay* r, int status) {
+    memset(&r->end, 0, sizeof(r->end));
+    r->end.base.type = MSG_REPLAY_END;
+    r->end.base.client_id = 0;
+    r->end.base.data_len = sizeof(ReplayEndMessage) - sizeof(BaseMessage);
+    r->end.game_id = r->game_id;
+    r->end.status = (uint8_t)status;
+    r->end_ready = 1;
+    if (status != REPLAY_DONE) printf("Replay of game %d for client %d ended with status %d\n", r->game_id, r->client_id, status);
+}
+
+// Send what is queued: 1 nothing left, 0 socket busy or full, -1 gone
+static int flush(Replay* r) {
+    if (r->frame_ready) {
+        int sent = replay_send(r->client_id, r->conn, &r->frame, sizeof(BaseMessage) + r->frame.base.data_len);
+        if (sent <= 0) return sent;
+        r->frame_ready = 0;
+    }
+    if (r->end_ready) {
+        int sent = replay_send(r->client_id, r->conn, &r->end, sizeof(r->end));
+        if (sent <= 0) return sent;
+        r->end_ready = 0;
+        r->done = 1;
+    }
+    return 1;
+}
+
+// Look the row up; 0 if it can be replayed
+static int open_replay(Replay* r) {
+    int status = REPLAY_NOT_FOUND;
+    sqlite3_bind_int(info_stmt, 1, r->game_id);
+    if (sqlite3_step(info_stmt) == SQLITE_ROW && sqlite3_column_int(info_stmt, 0) == DRAWING_FORMAT) {
+        r->size = sqlite3_column_int64(info_stmt, 1);
+        status = REPLAY_DONE;
+    }
+    sqlite3_reset(info_stmt);
+    return status;
+}
+
+// Top the buffer up with the next chunk of the blob, keeping undecoded bytes
+static int read_chunk(Replay* r) {
+    size_t left = (size_t)(r->dec.end - r->dec.p);
+    memmove(r->buf, r->dec.p, left);
+    int want = (int)(sizeof(r->buf) - left);
+    if (want > r->size - r->offset) want = (int)(r->size - r->offset);
+
+    sqlite3_blob* blob;
+    if (sqlite3_blob_open(conn, "main", "drawings", "data", r->game_id, 0, &blob) != SQLITE_OK) return -1;
+    int rc = sqlite3_blob_read(blob, r->buf + left, want, (int)r->offset);
+    sqlite3_blob_close(blob);
+    if (rc != SQLITE_OK) return -1;
+
+    r->offset += want;
+    r->buf_len = left + (size_t)want;
+    drawing_decoder_feed(&r->dec, r->buf, r->buf_len);
+    return 0;
+}
+
+// 1 with r->next set, 0 at the end, -1 on error
+static int next_point(Replay* r) {
+    size_t left = (size_t)(r->dec.end - r->dec.p);
+    if (left < DRAWING_POINT_MAX_BYTES && r->offset < r->size && read_chunk(r) != 0) return -1;
+    return drawing_decoder_next(&r->dec, &r->next);
+}
+
+// Advance one replay; returns when it next needs a pass (now or earlier
+// to go again at once), or 0 once it is over
+static long long step(Replay* r, long long now) {
+    int sent = flush(r);
+    if (sent > 0) r->stalled_ms = 0;
+    if (sent < 0) return 0;
+    if (sent == 0) {
+        if (r->stalled_ms == 0) r->stalled_ms = now;
+        if (now - r->stalled_ms < REPLAY_STALL_MS) return now + REPLAY_RETRY_MS;
+        printf("Replay of game %d for client %d dropped, client not reading\n", r->game_id, r->client_id);
+        return 0;
+    }
+    if (r->done) return 0;
+
+    long long elapsed = now - r->start_ms;
+    int frames = r->speed == 0 ? REPLAY_INSTANT_FRAMES : 1;
+    while (frames-- > 0) {
+        r->frame.count = 0;
+        while (r->frame.count < REPLAY_BATCH_POINTS) {
+            if (!r->has_next && !r->finished) {
+                int rc = next_point(r);
+                if (rc < 0) {
+                    queue_end(r, REPLAY_FAILED);
+                    break;
+                }
+                r->has_next = rc;
+                r->finished = rc == 0;
+            }
+            if (!r->has_next) break;
+            if (r->speed > 0 && r->next.t_ms / r->speed > elapsed) break;
+            ReplayPoint* pt = &r->frame.points[r->frame.count++];
+            pt->x = r->next.x;
+            pt->y = r->next.y;
+            pt->action = r->next.action;
+            pt->color_r = r->next.color_r;
+            pt->color_g = r->next.color_g;
+            pt->color_b = r->next.color_b;
+            r->has_next = 0;
+        }
+        if (r->frame.count > 0) {
+            r->frame.base.type = MSG_REPLAY_DATA;
+            r->frame.base.client_id = 0;
+            r->frame.game_id = r->game_id;
+            r->frame.base.data_len = offsetof(ReplayDataMessage, points[r->frame.count]) - sizeof(BaseMessage);
+            r->frame_ready = 1;
+        }
+        if (!r->end_ready && r->finished && !r->has_next) queue_end(r, REPLAY_DONE);
+        if (!r->frame_ready && !r->end_ready) break;
+        sent = flush(r);
+        if (sent < 0 || r->done) return 0;
+        if (sent == 0) {
+            r->stalled_ms = now;
+            return now + REPLAY_RETRY_MS;
+        }
+    }
+    if (r->speed == 0 || !r->has_next) return now; // more to send right away
+    return r->start_ms + r->next.t_ms / r->speed;
+}
+
+static void* replay_thread(void* arg) {
+    (void)arg;
+    while (1) {
+        long long now = mono_ms();
+        long long wake = now + 1000;
+        int running = 0;
+        for (int i = 0; i < REPLAY_MAX_ACTIVE; i++) {
+            Replay* r = &replays[i];
+            int owner = __atomic_load_n(&r->owner, __ATOMIC_ACQUIRE);
+            if (owner == REPLAY_FREE) continue;
+            long long due = 0;
+            if (owner != REPLAY_CANCELLED) {
+                if (r->start_ms == 0) {
+                    r->start_ms = now;
+                    int status = open_replay(r);
+                    if (status != REPLAY_DONE) queue_end(r, status);
+                }
+                due = step(r, now);
+            }
+            if (due == 0) {
+                __atomic_store_n(&r->owner, REPLAY_FREE, __ATOMIC_RELEASE);
+                continue;
+            }
+            running++;
+            if (due < wake) wake = due;
+        }
+
+        // Sleep until the next point is due or a replay is added
+        pthread_mutex_lock(&replay_mutex);
+        if (!replay_pending && wake > now) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            long long ns = until.tv_nsec + (wake - now) * 1000000LL;
+            until.tv_sec += ns / 1000000000LL;
+            until.tv_nsec = ns % 1000000000LL;
+            if (running == 0) pthread_cond_wait(&replay_added, &replay_mutex);
+            else pthread_cond_timedwait(&replay_added, &replay_mutex, &until);
+        }
+        replay_pending = 0;
+        pthread_mutex_unlock(&replay_mutex);
+    }
+    return NULL;
+}
+
+int replay_start(const char* db_path, ReplaySendFn send_fn) {
+    if (sqlite3_open_v2(db_path, &conn, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(conn, "SELECT format, length(data) FROM drawings WHERE game_id = ?;", -1, &info_stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Replay: can't open %s: %s\n", db_path, sqlite3_errmsg(conn));
+        sqlite3_close(conn);
+        conn = NULL;
+        return -1;
+    }
+    sqlite3_busy_timeout(conn, 1000);
+    replay_send = send_fn;
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, replay_thread, NULL) != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
+
+int replay_request(int client_id, unsigned client_conn, int game_id, int speed) {
+    if (!conn) return -1;
+    if (speed < 0) speed = 0;
+    if (speed > REPLAY_MAX_SPEED) speed = REPLAY_MAX_SPEED;
+
+    pthread_mutex_lock(&replay_mutex);
+    replay_cancel(client_id);
+    Replay* slot = NULL;
+    for (int i = 0; i < REPLAY_MAX_ACTIVE && !slot; i++) {
+        if (__atomic_load_n(&replays[i].owner, __ATOMIC_ACQUIRE) == REPLAY_FREE) slot = &replays[i];
+    }
+    if (slot) {
+        memset((char*)slot + offsetof(Replay, client_id), 0, sizeof(*slot) - offsetof(Replay, client_id));
+        slot->client_id = client_id;
+        slot->conn = client_conn;
+        slot->game_id = game_id;
+        slot->speed = speed;
+        drawing_decoder_init(&slot->dec, slot->buf, 0);
+        __atomic_store_n(&slot->owner, client_id + 1, __ATOMIC_RELEASE);
+        replay_pending = 1;
+        pthread_cond_signal(&replay_added);
+    }
+    pthread_mutex_unlock(&replay_mutex);
+    return slot ? 0 : -1;
+}
+
+void replay_cancel(int client_id) {
+    for (int i = 0; i < REPLAY_MAX_ACTIVE; i++) {
+        int owner = client_id + 1;
+        __atomic_compare_exchange_n(&replays[i].owner, &owner, REPLAY_CANCELLED, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+}
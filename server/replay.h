@@ -0,0 +1,38 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+
+// Replays of stored rounds (drawings table) streamed to clients as
+// MSG_REPLAY_DATA frames, paced by one scheduler thread: a point drawn t ms
+// into the round is sent t / speed ms after the replay starts, or as fast
+// as the socket takes it at speed 0.
+//
+// The scheduler has its own read-only connection and reads each blob
+// sequentially in REPLAY_READ_CHUNK pieces, opening it only for the read,
+// so no snapshot is held between chunks and the game connection is never
+// touched. Reads and sends happen outside replay_mutex, which only
+// serializes requests. Frames (REPLAY_END included) go out through the
+// server's per-client send path without waiting: a busy or full socket is
+// retried on a later pass, so a slow client only delays its own replay,
+// and one that takes nothing for REPLAY_STALL_MS loses it.
+
+#define REPLAY_MAX_ACTIVE 32
+#define REPLAY_READ_CHUNK 4096
+#define REPLAY_INSTANT_FRAMES 8 // per replay per pass at speed 0
+#define REPLAY_RETRY_MS 10      // after a busy or full socket
+#define REPLAY_STALL_MS 10000
+
+// Send one whole frame to a client connection without waiting: 1 sent,
+// 0 nothing sent (try again later), -1 the connection is gone
+typedef int (*ReplaySendFn)(int client_id, unsigned conn, const void* buf, size_t len);
+
+int replay_start(const char* db_path, ReplaySendFn send_fn);
+
+// Start replaying game_id to a client connection, replacing any replay it
+// already has; -1 when REPLAY_MAX_ACTIVE are running
+int replay_request(int client_id, unsigned conn, int game_id, int speed);
+// Drop the client's replays; never blocks, so it is safe under any lock
+void replay_cancel(int client_id);
+
+#endif
@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+#include "metrics.h"
+#include "retention.h"
+
+static DbConfig retention_cfg;
+
+static void sleep_ms(long long ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {}
+}
+
+static long long pragma_int(sqlite3* conn, const char* sql) {
+    sqlite3_stmt* stmt;
+    long long value = -1;
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) value = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+// One write step queued on the DB writer; the retention thread waits for it
+typedef struct {
+    DbWrite write; // first, so done() gets the job back
+    sqlite3_int64 arg1, arg2;
+    long long changes;
+    int finished, ok;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} RetentionJob;
+
+static void job_done(DbWrite* w, int ok) {
+    RetentionJob* job = (RetentionJob*)w;
+    pthread_mutex_lock(&job->mutex);
+    job->ok = ok;
+    job->finished = 1;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->mutex);
+}
+
+// Queue one step and wait until it is committed; 0 if it was
+static int run_job(RetentionJob* job, int (*apply)(DbWrite*), sqlite3_int64 arg1, sqlite3_int64 arg2) {
+    job->write.apply = apply;
+    job->write.done = job_done;
+    job->arg1 = arg1;
+    job->arg2 = arg2;
+    job->changes = 0;
+    job->finished = 0;
+    db_write(&job->write);
+    pthread_mutex_lock(&job->mutex);
+    while (!job->finished) pthread_cond_wait(&job->cond, &job->mutex);
+    pthread_mutex_unlock(&job->mutex);
+    return job->ok ? 0 : -1;
+}
+
+// Run a write statement to completion on the writer connection
+static int apply_stmt(RetentionJob* job, DbStmtId id, int binds) {
+    sqlite3_stmt* stmt = db_stmt_acquire(id);
+    int rc = SQLITE_ERROR;
+    if (stmt) {
+        if (binds > 0) sqlite3_bind_int64(stmt, 1, job->arg1);
+        if (binds > 1) sqlite3_bind_int64(stmt, 2, job->arg2);
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {} // incremental_vacuum frees a page per step
+        job->changes = sqlite3_changes(sqlite3_db_handle(stmt));
+        if (rc != SQLITE_DONE) fprintf(stderr, "SQL error (retention): %s\n", sqlite3_errmsg(sqlite3_db_handle(stmt)));
+    }
+    db_stmt_release(id);
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+static int delete_drawings_apply(DbWrite* w) {
+    return apply_stmt((RetentionJob*)w, DB_STMT_DELETE_DRAWINGS, 2);
+}
+
+static int delete_history_apply(DbWrite* w) {
+    return apply_stmt((RetentionJob*)w, DB_STMT_DELETE_HISTORY, 1);
+}
+
+static int vacuum_apply(DbWrite* w) {
+    return apply_stmt((RetentionJob*)w, DB_STMT_VACUUM_STEP, 0);
+}
+
+// page_count, freelist_count, page_size, auto_vacuum as of the last commit
+static int page_stats(long long stats[4]) {
+    sqlite3_stmt* stmt = db_read_acquire(DB_STMT_PAGE_STATS);
+    int rc = stmt && sqlite3_step(stmt) == SQLITE_ROW ? 0 : -1;
+    for (int i = 0; i < 4; i++) stats[i] = rc == 0 ? sqlite3_column_int64(stmt, i) : -1;
+    db_read_release(stmt);
+    return rc;
+}
+
+// Oldest first through the created_at index, batch rows per write job
+static int prune_drawings(RetentionJob* job, const DbConfig* cfg, long long* deleted) {
+    sqlite3_int64 cutoff = (sqlite3_int64)time(NULL) - (sqlite3_int64)cfg->drawing_retention_days * 86400;
+    while (1) {
+        if (run_job(job, delete_drawings_apply, cutoff, cfg->retention_batch) != 0) return -1;
+        *deleted += job->changes;
+        if (job->changes < cfg->retention_batch) return 0;
+        sleep_ms(RETENTION_PAUSE_MS);
+    }
+}
+
+// record_id grows with game_time, so old rows are a prefix of the table.
+// The prefix is found on the reader pool; only the rowid range delete
+// goes to the writer.
+static int prune_history(RetentionJob* job, const DbConfig* cfg, long long* deleted) {
+    char cutoff[32];
+    time_t then = time(NULL) - (time_t)cfg->history_retention_days * 86400;
+    strftime(cutoff, sizeof(cutoff), "%Y-%m-%d %H:%M:%S", localtime(&then)); // as end_game writes it
+
+    while (1) {
+        sqlite3_stmt* head = db_read_acquire(DB_STMT_HISTORY_HEAD);
+        if (!head) return -1;
+        sqlite3_bind_int(head, 1, cfg->retention_batch);
+        long long last_old = -1;
+        int rows = 0, rc;
+        while ((rc = sqlite3_step(head)) == SQLITE_ROW) {
+            const char* game_time = (const char*)sqlite3_column_text(head, 1);
+            if (strcmp(game_time ? game_time : "", cutoff) >= 0) break;
+            last_old = sqlite3_column_int64(head, 0);
+            rows++;
+        }
+        db_read_release(head);
+        if (rc != SQLITE_ROW && rc != SQLITE_DONE) return -1;
+        if (rows == 0) return 0;
+
+        if (run_job(job, delete_history_apply, last_old, 0) != 0) return -1;
+        *deleted += job->changes;
+        if (rows < cfg->retention_batch) return 0;
+        sleep_ms(RETENTION_PAUSE_MS);
+    }
+}
+
+// Hand free pages back a few at a time; needs auto_vacuum=incremental
+static int vacuum_free_pages(RetentionJob* job) {
+    long long stats[4];
+    long long free_pages = -1;
+    while (page_stats(stats) == 0 && stats[1] > 0) {
+        if (free_pages >= 0 && stats[1] >= free_pages) return 0; // nothing more to give back
+        free_pages = stats[1];
+        if (run_job(job, vacuum_apply, 0, 0) != 0) return -1;
+        metric_add(METRIC_DB_VACUUM_PAGES, free_pages < RETENTION_VACUUM_PAGES ? free_pages : RETENTION_VACUUM_PAGES);
+        sleep_ms(RETENTION_PAUSE_MS);
+    }
+    return stats[1] < 0 ? -1 : 0;
+}
+
+int retention_run(const DbConfig* cfg, RetentionReport* report) {
+    RetentionJob job;
+    memset(&job, 0, sizeof(job));
+    pthread_mutex_init(&job.mutex, NULL);
+    pthread_cond_init(&job.cond, NULL);
+    memset(report, 0, sizeof(*report));
+    long long stats[4];
+    page_stats(stats);
+    report->page_size = (int)stats[2];
+    report->pages_before = stats[0];
+
+    int rc = 0;
+    if (cfg->drawing_retention_days > 0 && prune_drawings(&job, cfg, &report->drawings) != 0) rc = -1;
+    if (rc == 0 && cfg->history_retention_days > 0 && prune_history(&job, cfg, &report->history) != 0) rc = -1;
+    metric_add(METRIC_DB_RETENTION_ROWS, report->drawings + report->history);
+    if (rc == 0 && stats[3] == 2 && vacuum_free_pages(&job) != 0) rc = -1;
+    if (rc != 0) fprintf(stderr, "Retention stopped on a database error\n");
+
+    page_stats(stats);
+    report->pages_after = stats[0];
+    report->free_pages = stats[1];
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.mutex);
+    return rc;
+}
+
+static void* retention_thread(void* arg) {
+    (void)arg;
+#ifdef __linux__
+    // Per-thread on Linux: only this thread yields the CPU
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), RETENTION_NICE);
+#endif
+    sleep_ms(RETENTION_FIRST_DELAY * 1000LL);
+    while (1) {
+        RetentionReport report;
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        retention_run(&retention_cfg, &report);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        long long kb = report.page_size / 1024;
+        if (report.drawings > 0 || report.history > 0 || report.pages_after < report.pages_before) {
+            printf("Retention: deleted %lld drawings and %lld history rows, database %lld KB -> %lld KB"
+                   " (%lld KB reclaimed) in %.1fs\n",
+                   report.drawings, report.history, report.pages_before * kb, report.pages_after * kb,
+                   (report.pages_before - report.pages_after) * kb,
+                   (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9);
+        }
+        if (report.free_pages > 0 && (report.drawings > 0 || report.history > 0)) {
+            printf("Retention: %lld KB free inside the file, reused by new rows"
+                   " (run --compact-db once to shrink it)\n", report.free_pages * kb);
+        }
+        sleep_ms(retention_cfg.retention_interval * 1000LL);
+    }
+    return NULL;
+}
+
+void retention_start(const DbConfig* cfg) {
+    if (cfg->drawing_retention_days <= 0 && cfg->history_retention_days <= 0) return;
+    retention_cfg = *cfg;
+    if (retention_cfg.retention_batch <= 0) retention_cfg.retention_batch = 500;
+    if (retention_cfg.retention_interval <= 0) retention_cfg.retention_interval = 3600;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, retention_thread, NULL) != 0) return;
+    pthread_detach(thread);
+    printf("Retention: drawings %d days, history %d days (0 = forever), every %ds in batches of %d\n",
+           retention_cfg.drawing_retention_days, retention_cfg.history_retention_days,
+           retention_cfg.retention_interval, retention_cfg.retention_batch);
+}
+
+int retention_compact(sqlite3* conn) {
+    long long page_size = pragma_int(conn, "PRAGMA page_size;");
+    long long before = pragma_int(conn, "PRAGMA page_count;");
+    printf("Compacting database (%lld KB)...\n", before * page_size / 1024);
+    // Changing auto_vacuum on an existing file only takes effect through VACUUM
+    if (sqlite3_exec(conn, "PRAGMA auto_vacuum=INCREMENTAL; VACUUM;", 0, 0, 0) != SQLITE_OK) {
+        fprintf(stderr, "SQL error (compact): %s\n", sqlite3_errmsg(conn));
+        return -1;
+    }
+    long long after = pragma_int(conn, "PRAGMA page_count;");
+    printf("Compacted to %lld KB (%lld KB reclaimed), incremental vacuum enabled\n",
+           after * page_size / 1024, (before - after) * page_size / 1024);
+    return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef RETENTION_H
+#define RETENTION_H
+
+#include "sqlite3.h"
+#include "db.h"
+
+// Retention job: a background thread that drops drawings older than
+// drawing_retention_days and history rows older than
+// history_retention_days (0 keeps them forever), then gives the freed pages
+// back to the filesystem with incremental vacuum. It writes nothing
+// itself: every delete and vacuum step is a DbWrite job of at most
+// retention_batch rows or RETENTION_VACUUM_PAGES pages on the writer
+// connection, with a pause in between, and the scans that pick the rows
+// run on the reader pool. A live round's commit waits a few milliseconds
+// at most.
+
+#define RETENTION_FIRST_DELAY 60     // seconds after startup before the first pass
+#define RETENTION_PAUSE_MS 50        // between write steps
+#define RETENTION_VACUUM_PAGES 256   // pages per incremental_vacuum step
+#define RETENTION_NICE 10            // thread nice value (Linux)
+
+typedef struct {
+    long long drawings;      // rows deleted
+    long long history;
+    long long pages_before;  // database size in pages
+    long long pages_after;
+    long long free_pages;    // left on the freelist (auto_vacuum off)
+    int page_size;
+} RetentionReport;
+
+// One pass through the DB writer and reader pool with the report filled
+// in; -1 if it stopped on an error
+int retention_run(const DbConfig* cfg, RetentionReport* report);
+
+// Start the background job (nothing to do when both retentions are 0)
+void retention_start(const DbConfig* cfg);
+
+// draw_guess_server --compact-db: switch the file to incremental
+// auto-vacuum and rebuild it (offline, takes the whole database)
+int retention_compact(sqlite3* conn);
+
+#endif
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "stroke_buffer.h"
+
+// Free chunks, shared by all rooms. Released buffers are spliced on whole,
+// trimming happens later outside the round path.
+static pthread_mutex_t arena_mutex = PTHREAD_MUTEX_INITIALIZER;
+static StrokeChunk* free_chunks = NULL;
+static int free_count = 0;
+
+static StrokeChunk* arena_take(void) {
+    pthread_mutex_lock(&arena_mutex);
+    StrokeChunk* chunk = free_chunks;
+    if (chunk) {
+        free_chunks = chunk->next;
+        free_count--;
+    }
+    pthread_mutex_unlock(&arena_mutex);
+    if (!chunk) chunk = malloc(sizeof(StrokeChunk));
+    if (chunk) {
+        chunk->next = NULL;
+        chunk->count = 0;
+    }
+    return chunk;
+}
+
+void stroke_buffer_init(StrokeBuffer* buf, long long start_ms) {
+    buf->head = NULL;
+    buf->tail = NULL;
+    buf->count = 0;
+    buf->chunks = 0;
+    buf->start_ms = start_ms;
+}
+
+int stroke_buffer_append(StrokeBuffer* buf, uint16_t x, uint16_t y, uint8_t action,
+                         uint8_t color_r, uint8_t color_g, uint8_t color_b, long long now_ms) {
+    if (buf->count >= STROKE_MAX_POINTS) return -1;
+    if (!buf->tail || buf->tail->count == STROKE_CHUNK_POINTS) {
+        StrokeChunk* chunk = arena_take();
+        if (!chunk) return -1;
+        if (buf->tail) buf->tail->next = chunk;
+        else buf->head = chunk;
+        buf->tail = chunk;
+        buf->chunks++;
+    }
+
+    StrokePoint* pt = &buf->tail->points[buf->tail->count++];
+    pt->x = x;
+    pt->y = y;
+    pt->action = action;
+    pt->color_r = color_r;
+    pt->color_g = color_g;
+    pt->color_b = color_b;
+    pt->t_ms = now_ms > buf->start_ms ? (uint32_t)(now_ms - buf->start_ms) : 0;
+    buf->count++;
+    return 0;
+}
+
+void stroke_buffer_release(StrokeBuffer* buf) {
+    if (buf->head) {
+        pthread_mutex_lock(&arena_mutex);
+        buf->tail->next = free_chunks;
+        free_chunks = buf->head;
+        free_count += buf->chunks;
+        pthread_mutex_unlock(&arena_mutex);
+    }
+    stroke_buffer_init(buf, 0);
+}
+
+void stroke_arena_trim(void) {
+    StrokeChunk* extra = NULL;
+    pthread_mutex_lock(&arena_mutex);
+    if (free_count > STROKE_ARENA_KEEP_CHUNKS) {
+        StrokeChunk* last = free_chunks;
+        for (int i = 1; i < STROKE_ARENA_KEEP_CHUNKS; i++) last = last->next;
+        extra = last->next;
+        last->next = NULL;
+        free_count = STROKE_ARENA_KEEP_CHUNKS;
+    }
+    pthread_mutex_unlock(&arena_mutex);
+
+    int freed = 0;
+    while (extra) {
+        StrokeChunk* next = extra->next;
+        free(extra);
+        extra = next;
+        freed++;
+    }
+    if (freed > 0) printf("Stroke arena: freed %d idle chunks\n", freed);
+}
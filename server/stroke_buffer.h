@@ -0,0 +1,58 @@
+#ifndef STROKE_BUFFER_H
+#define STROKE_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-round stroke storage: a list of fixed-size chunks taken from a
+// process-wide arena. It grows one chunk at a time while the painter draws
+// and goes back to the arena in O(1) when the round ends, so an idle room
+// holds no point storage at all.
+
+#define STROKE_CHUNK_POINTS 1024
+#define STROKE_MAX_POINTS (256 * STROKE_CHUNK_POINTS) // per round, against runaway painters
+#define STROKE_ARENA_KEEP_CHUNKS 64 // free chunks kept by stroke_arena_trim
+
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint8_t action;
+    uint8_t color_r;
+    uint8_t color_g;
+    uint8_t color_b;
+    uint32_t t_ms; // since the start of the round
+} StrokePoint;
+
+typedef struct StrokeChunk {
+    struct StrokeChunk* next;
+    int count;
+    StrokePoint points[STROKE_CHUNK_POINTS];
+} StrokeChunk;
+
+typedef struct {
+    StrokeChunk* head;
+    StrokeChunk* tail;
+    int count;     // points
+    int chunks;
+    long long start_ms; // round start, now_ms() time base
+} StrokeBuffer;
+
+void stroke_buffer_init(StrokeBuffer* buf, long long start_ms);
+
+// Append one paint event; returns -1 when the round limit is reached or
+// memory runs out (the point is dropped)
+int stroke_buffer_append(StrokeBuffer* buf, uint16_t x, uint16_t y, uint8_t action,
+                         uint8_t color_r, uint8_t color_g, uint8_t color_b, long long now_ms);
+
+// Hand every chunk back to the arena and empty the buffer
+void stroke_buffer_release(StrokeBuffer* buf);
+
+// Bytes of point storage held by the buffer
+static inline size_t stroke_buffer_bytes(const StrokeBuffer* buf) {
+    return (size_t)buf->chunks * sizeof(StrokeChunk);
+}
+
+// Free arena chunks beyond STROKE_ARENA_KEEP_CHUNKS (called from the game timer)
+void stroke_arena_trim(void);
+
+#endif
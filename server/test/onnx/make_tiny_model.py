@@ -0,0 +1,60 @@
+# Writes a tiny stand-in for what export_onnx.py produces, so the onnx
+# backend can be tested offline without CLIP or torch (needs numpy + onnx):
+#   model/image_encoder.onnx   pixel_values [N,3,224,224] -> image_embeds [N,3],
+#                              the L2-normalized mean of each channel
+#   model/text_embeddings.bin  a few color names embedded the same way
+# Usage: python make_tiny_model.py [OUT_DIR]   (default: next to this file)
+import os
+import struct
+import sys
+import numpy as np
+import onnx
+from onnx import helper, TensorProto
+
+TEXT_TABLE_MAGIC = 0x45544744  # "DGTE", see EmbedTableHeader in embed_index.h
+CLIP_MEAN = np.array([0.48145466, 0.4578275, 0.40821073], dtype=np.float32)
+CLIP_STD = np.array([0.26862954, 0.26130258, 0.27577711], dtype=np.float32)
+COLORS = {
+    "red": (255, 0, 0),
+    "green": (0, 255, 0),
+    "blue": (0, 0, 255),
+    "white": (255, 255, 255),
+    "black": (0, 0, 0),
+    "yellow": (255, 255, 0),
+}
+
+def image_encoder():
+    nodes = [
+        helper.make_node("ReduceMean", ["pixel_values"], ["means"], axes=[2, 3], keepdims=0),
+        helper.make_node("LpNormalization", ["means"], ["image_embeds"], axis=-1, p=2),
+    ]
+    graph = helper.make_graph(
+        nodes, "tiny_image_encoder",
+        [helper.make_tensor_value_info("pixel_values", TensorProto.FLOAT, ["batch", 3, 224, 224])],
+        [helper.make_tensor_value_info("image_embeds", TensorProto.FLOAT, ["batch", 3])])
+    model = helper.make_model(graph, opset_imports=[helper.make_opsetid("", 17)])
+    model.ir_version = 8
+    onnx.checker.check_model(model)
+    return model
+
+def color_embedding(rgb):
+    v = (np.array(rgb, dtype=np.float32) / 255.0 - CLIP_MEAN) / CLIP_STD
+    return v / np.linalg.norm(v)
+
+def main():
+    out_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.abspath(__file__))
+    model_dir = os.path.join(out_dir, "model")
+    os.makedirs(model_dir, exist_ok=True)
+    onnx.save(image_encoder(), os.path.join(model_dir, "image_encoder.onnx"))
+
+    words = list(COLORS)
+    matrix = np.stack([color_embedding(COLORS[w]) for w in words]).astype(np.float32)
+    block = b"".join(w.encode("utf-8") + b"\0" for w in words)
+    with open(os.path.join(model_dir, "text_embeddings.bin"), "wb") as f:
+        f.write(struct.pack("<IIIfI", TEXT_TABLE_MAGIC, len(words), matrix.shape[1], 100.0, len(block)))
+        f.write(block)
+        f.write(np.ascontiguousarray(matrix).tobytes())
+    print(f"Wrote {model_dir}/image_encoder.onnx and {len(words)} word embeddings")
+
+if __name__ == "__main__":
+    main()
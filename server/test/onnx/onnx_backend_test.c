@@ -0,0 +1,91 @@
+// Offline test of the onnx backend (ai_onnx.c) against the tiny model in
+// model/ next to this file (written by make_tiny_model.py; no CLIP needed).
+// Build from server/ with ONNX Runtime's headers and library:
+//   gcc -Wall -O2 -DWITH_ONNXRUNTIME -I. -I$ORT/include test/onnx/onnx_backend_test.c
+//       ai_onnx.c ai_client.c embed_index.c metrics.c -L$ORT/lib -lonnxruntime -lpthread -lm
+//       -o onnx_backend_test
+// and run it from server/test/onnx (the backend opens model/ relative to
+// the working directory). Exits non-zero on the first failed check.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ai_backend.h"
+#include "ai_client.h"
+#include "embed_index.h"
+#include "raster.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do {                  \
+        if (!(cond)) {                         \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);               \
+            printf("\n");                      \
+            failures++;                        \
+        }                                      \
+    } while (0)
+
+// Words in the exported table, in a different order than the table
+static const char bank[] = "yellow\0black\0white\0blue\0green\0red";
+static const char* const colors[] = { "red", "green", "blue", "white", "black", "yellow" };
+static const uint8_t rgb[][3] = { {255, 0, 0}, {0, 255, 0}, {0, 0, 255}, {255, 255, 255}, {0, 0, 0}, {255, 255, 0} };
+#define COLORS 6
+
+int main(void) {
+    const AiBackend* onnx = &ai_backend_onnx;
+    if (onnx->start() != 0 || !onnx->ready()) {
+        printf("FAIL: backend did not start (run make_tiny_model.py, then run from its directory)\n");
+        return 1;
+    }
+
+    // Every word of the bank comes from the table
+    EmbedIndex* idx = onnx->encode_words(1, bank, sizeof(bank), COLORS);
+    CHECK(idx != NULL, "encode_words returned NULL for words that are all in the table");
+    if (!idx) return 1;
+    CHECK(idx->count == COLORS && idx->dim == 3, "index has %d words x %d dims", idx->count, idx->dim);
+
+    // A word the table does not have fails the whole bank instead of
+    // falling back to a service that is not running
+    static const char stale[] = "red\0unicorn";
+    EmbedIndex* none = onnx->encode_words(2, stale, sizeof(stale), 2);
+    CHECK(none == NULL, "encode_words accepted a word missing from the table");
+    embed_index_release(none);
+
+    // One solid raster per color in a single batch; each must rank its own
+    // color first
+    Raster* rasters = malloc(sizeof(Raster) * COLORS);
+    const Raster* batch[COLORS];
+    for (int i = 0; i < COLORS; i++) {
+        for (int c = 0; c < 3; c++) memset(rasters[i].planes[c], rgb[i][c], RASTER_PIXELS);
+        batch[i] = &rasters[i];
+    }
+    float* embeddings = NULL;
+    int dim = 0;
+    int rc = onnx->encode_images(batch, COLORS, ai_clock_ms() + 10000, &embeddings, &dim);
+    CHECK(rc == 0 && dim == 3, "encode_images rc %d dim %d", rc, dim);
+    for (int i = 0; rc == 0 && i < COLORS; i++) {
+        EmbedMatch best;
+        int target = embed_index_find(idx, colors[i]);
+        float target_prob = 0.0f;
+        int found = embed_index_rank(idx, embeddings + (size_t)i * dim, 1, &best, target, &target_prob);
+        CHECK(found == 1 && strcmp(idx->word[best.index], colors[i]) == 0,
+              "%s raster ranked '%s' first", colors[i], found ? idx->word[best.index] : "(none)");
+        CHECK(target_prob > 0.5f, "%s raster gives its word %.3f", colors[i], target_prob);
+    }
+
+    // A past deadline is refused before running the model
+    float* late = NULL;
+    CHECK(onnx->encode_images(batch, 1, ai_clock_ms() - 1, &late, &dim) != 0, "late batch was run");
+    free(late);
+
+    free(embeddings);
+    free(rasters);
+    embed_index_release(idx);
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("onnx backend: all checks passed\n");
+    return 0;
+}
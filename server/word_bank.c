@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "db.h"
+#include "word_bank.h"
+
+static WordBank* current = NULL;
+static pthread_mutex_t bank_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t load_mutex = PTHREAD_MUTEX_INITIALIZER; // one reload at a time
+
+static void free_bank(WordBank* bank) {
+    free(bank->groups);
+    free(bank->category);
+    free(bank->word);
+    free(bank->block);
+    free(bank);
+}
+
+WordBank* word_bank_acquire(void) {
+    pthread_mutex_lock(&bank_mutex);
+    WordBank* bank = current;
+    if (bank) bank->refs++;
+    pthread_mutex_unlock(&bank_mutex);
+    return bank;
+}
+
+void word_bank_release(WordBank* bank) {
+    if (!bank) return;
+    pthread_mutex_lock(&bank_mutex);
+    int last = --bank->refs == 0;
+    pthread_mutex_unlock(&bank_mutex);
+    if (last) free_bank(bank);
+}
+
+static uint32_t db_words_version(void) {
+    uint32_t version = 0;
+    sqlite3_stmt* stmt = db_read_acquire(DB_STMT_WORDS_VERSION);
+    if (sqlite3_step(stmt) == SQLITE_ROW) version = (uint32_t)sqlite3_column_int64(stmt, 0);
+    db_read_release(stmt);
+    return version;
+}
+
+static WordBank* read_bank(void) {
+    WordBank* bank = calloc(1, sizeof(WordBank));
+    if (!bank) return NULL;
+    size_t cap = 4096, len = 0;
+    uint32_t word_cap = 256, group_cap = 16, category_cap = 16;
+    bank->block = malloc(cap);
+    uint32_t* offsets = malloc(sizeof(uint32_t) * word_cap);
+    bank->groups = malloc(sizeof(WordGroup) * group_cap);
+    bank->category = malloc(sizeof(*bank->category) * category_cap);
+    int ok = bank->block && offsets && bank->groups && bank->category;
+
+    // Read the version first: a change racing the SELECT triggers one more reload
+    bank->version = db_words_version();
+    sqlite3_stmt* stmt = db_read_acquire(DB_STMT_ALL_WORDS);
+    while (ok && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* word = (const char*)sqlite3_column_text(stmt, 0);
+        const char* category = (const char*)sqlite3_column_text(stmt, 1);
+        int difficulty = sqlite3_column_int(stmt, 2);
+        if (!category) category = "";
+        size_t wlen = strlen(word) + 1;
+        if (len + wlen > cap) {
+            while (len + wlen > cap) cap *= 2;
+            char* grown = realloc(bank->block, cap);
+            if (!grown) break;
+            bank->block = grown;
+        }
+        if (bank->count == word_cap) {
+            uint32_t* grown = realloc(offsets, sizeof(uint32_t) * word_cap * 2);
+            if (!grown) break;
+            offsets = grown;
+            word_cap *= 2;
+        }
+
+        // Rows come sorted by category then difficulty: a change opens a group
+        WordGroup* group = bank->num_groups ? &bank->groups[bank->num_groups - 1] : NULL;
+        int new_category = !group || strncmp(bank->category[group->category], category, WORD_CATEGORY_MAX_LEN) != 0;
+        if (new_category || group->difficulty != difficulty) {
+            if (new_category && bank->num_categories == category_cap) {
+                void* grown = realloc(bank->category, sizeof(*bank->category) * category_cap * 2);
+                if (!grown) break;
+                bank->category = grown;
+                category_cap *= 2;
+            }
+            if (bank->num_groups == group_cap) {
+                WordGroup* grown = realloc(bank->groups, sizeof(WordGroup) * group_cap * 2);
+                if (!grown) break;
+                bank->groups = grown;
+                group_cap *= 2;
+            }
+            if (new_category) {
+                snprintf(bank->category[bank->num_categories++], WORD_CATEGORY_MAX_LEN + 1, "%s", category);
+            }
+            group = &bank->groups[bank->num_groups++];
+            group->category = (uint16_t)(bank->num_categories - 1);
+            group->difficulty = (uint8_t)difficulty;
+            group->start = bank->count;
+            group->count = 0;
+        }
+
+        memcpy(bank->block + len, word, wlen);
+        offsets[bank->count++] = (uint32_t)len;
+        group->count++;
+        len += wlen;
+    }
+    db_read_release(stmt);
+
+    bank->word = ok ? malloc(sizeof(char*) * (bank->count ? bank->count : 1)) : NULL;
+    if (!bank->word) {
+        free(offsets);
+        free_bank(bank);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < bank->count; i++) bank->word[i] = bank->block + offsets[i];
+    free(offsets);
+
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)bank->block[i];
+        hash *= 16777619u;
+    }
+    bank->set_id = hash;
+    bank->len = (uint32_t)len;
+    bank->refs = 1;
+    return bank;
+}
+
+int word_bank_load(void) {
+    pthread_mutex_lock(&load_mutex);
+    WordBank* bank = read_bank();
+    if (!bank) {
+        pthread_mutex_unlock(&load_mutex);
+        return -1;
+    }
+    pthread_mutex_lock(&bank_mutex);
+    WordBank* old = current;
+    current = bank;
+    pthread_mutex_unlock(&bank_mutex);
+    pthread_mutex_unlock(&load_mutex);
+    word_bank_release(old);
+    printf("Loaded %u words in %u categories (version %u, set %08x)\n",
+           bank->count, bank->num_categories, bank->version, bank->set_id);
+    return 0;
+}
+
+void word_bank_refresh(void) {
+    uint32_t version = db_words_version();
+    WordBank* bank = word_bank_acquire();
+    int stale = !bank || bank->version != version;
+    word_bank_release(bank);
+    if (stale) word_bank_load();
+}
+
+static uint32_t bag_rand(WordBag* bag) {
+    // xorshift32
+    uint32_t x = bag->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    bag->rng = x;
+    return x;
+}
+
+void word_bag_init(WordBag* bag, uint32_t seed) {
+    memset(bag, 0, sizeof(*bag));
+    bag->last = UINT32_MAX;
+    bag->rng = seed ? seed : 0x9E3779B9u;
+}
+
+void word_bag_free(WordBag* bag) {
+    free(bag->order);
+    bag->order = NULL;
+    bag->cap = 0;
+    bag->len = 0;
+    bag->pos = 0;
+    bag->version = 0;
+}
+
+void word_bag_set_filter(WordBag* bag, const char* category, int difficulty) {
+    snprintf(bag->category, sizeof(bag->category), "%s", category ? category : "");
+    bag->difficulty = difficulty > 0 && difficulty <= WORD_DIFFICULTY_MAX ? (uint8_t)difficulty : 0;
+    bag->version = 0;
+}
+
+// Collect the word indices of every group passing the filter
+static uint32_t bag_collect(WordBag* bag, const WordBank* bank) {
+    uint32_t n = 0;
+    for (uint32_t g = 0; g < bank->num_groups; g++) {
+        const WordGroup* group = &bank->groups[g];
+        if (bag->category[0] && strcmp(bank->category[group->category], bag->category) != 0) continue;
+        if (bag->difficulty && group->difficulty != bag->difficulty) continue;
+        for (uint32_t i = 0; i < group->count; i++) bag->order[n++] = group->start + i;
+    }
+    return n;
+}
+
+static int bag_refill(WordBag* bag, const WordBank* bank) {
+    if (bag->version != bank->version || !bag->order) {
+        if (bag->cap < bank->count || !bag->order) {
+            uint32_t* order = realloc(bag->order, sizeof(uint32_t) * (bank->count ? bank->count : 1));
+            if (!order) return -1;
+            bag->order = order;
+            bag->cap = bank->count;
+        }
+        bag->len = bag_collect(bag, bank);
+        if (bag->len == 0) {
+            printf("Word bag: nothing in category '%s' difficulty %d, using every word\n",
+                   bag->category, bag->difficulty);
+            bag->len = bank->count;
+            for (uint32_t i = 0; i < bag->len; i++) bag->order[i] = i;
+        }
+        bag->version = bank->version;
+        if (bag->last >= bank->count) bag->last = UINT32_MAX;
+    }
+    // Fisher-Yates
+    for (uint32_t i = bag->len; i > 1; i--) {
+        uint32_t j = bag_rand(bag) % i;
+        uint32_t t = bag->order[i - 1];
+        bag->order[i - 1] = bag->order[j];
+        bag->order[j] = t;
+    }
+    if (bag->len > 1 && bag->order[0] == bag->last) {
+        uint32_t j = 1 + bag_rand(bag) % (bag->len - 1);
+        bag->order[0] = bag->order[j];
+        bag->order[j] = bag->last;
+    }
+    bag->pos = 0;
+    return 0;
+}
+
+int word_bag_next(WordBag* bag, char* out, int size) {
+    WordBank* bank = word_bank_acquire();
+    if (!bank || bank->count == 0) {
+        word_bank_release(bank);
+        return -1;
+    }
+    // A reload or a new filter starts a fresh bag
+    if ((bag->version != bank->version || bag->pos >= bag->len) && bag_refill(bag, bank) != 0) {
+        word_bank_release(bank);
+        return -1;
+    }
+    uint32_t index = bag->order[bag->pos++];
+    bag->last = index;
+    strncpy(out, bank->word[index], size - 1);
+    out[size - 1] = '\0';
+    word_bank_release(bank);
+    return 0;
+}
+
+// Split off the next tab- or comma-separated field, trimmed
+static char* next_field(char** p) {
+    char* start = *p;
+    if (!start) return NULL;
+    while (*start == ' ') start++;
+    char* end = start + strcspn(start, "\t,");
+    *p = *end ? end + 1 : NULL;
+    *end = '\0';
+    while (end > start && (end[-1] == ' ' || end[-1] == '\r' || end[-1] == '\n')) *--end = '\0';
+    return start;
+}
+
+int word_bank_import(sqlite3* conn, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return -1;
+    }
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(conn, "INSERT INTO words (word, category, difficulty, language) VALUES (?, ?, ?, ?)"
+                                 " ON CONFLICT(word) DO UPDATE SET category = excluded.category,"
+                                 " difficulty = excluded.difficulty, language = excluded.language;",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "SQL error (import): %s\n", sqlite3_errmsg(conn));
+        fclose(f);
+        return -1;
+    }
+
+    sqlite3_exec(conn, "BEGIN;", 0, 0, 0);
+    char line[256];
+    int line_no = 0, written = 0, skipped = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        if (!strchr(line, '\n')) {
+            // Longer than the buffer: drop the rest instead of reading it as a new line
+            int c = getc(f), truncated = c != '\n' && c != EOF;
+            while (c != '\n' && c != EOF) c = getc(f);
+            if (truncated) {
+                if (line[0] != '#' && skipped++ < 10) fprintf(stderr, "%s:%d: skipped, line too long\n", path, line_no);
+                continue;
+            }
+        }
+        if (line[0] == '#') continue;
+        char* p = line;
+        char* word = next_field(&p);
+        char* category = next_field(&p);
+        char* difficulty = next_field(&p);
+        char* language = next_field(&p);
+        if (!word || !word[0]) continue;
+        int level = difficulty && difficulty[0] ? atoi(difficulty) : 1;
+        if (strlen(word) > WORD_MAX_LEN || (category && strlen(category) > WORD_CATEGORY_MAX_LEN) ||
+            (language && strlen(language) > WORD_LANGUAGE_MAX_LEN) || level < 1 || level > WORD_DIFFICULTY_MAX) {
+            if (skipped++ < 10) fprintf(stderr, "%s:%d: skipped\n", path, line_no);
+            continue;
+        }
+        sqlite3_bind_text(stmt, 1, word, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, category && category[0] ? category : "general", -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 3, level);
+        sqlite3_bind_text(stmt, 4, language && language[0] ? language : "en", -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) == SQLITE_DONE) written++;
+        sqlite3_reset(stmt);
+    }
+    fclose(f);
+    sqlite3_finalize(stmt);
+    if (sqlite3_exec(conn, "COMMIT;", 0, 0, 0) != SQLITE_OK) {
+        fprintf(stderr, "SQL error (import commit): %s\n", sqlite3_errmsg(conn));
+        sqlite3_exec(conn, "ROLLBACK;", 0, 0, 0);
+        return -1;
+    }
+    printf("Imported %d words from %s (%d lines skipped)\n", written, path, skipped);
+    return written;
+}
@@ -0,0 +1,81 @@
+#ifndef WORD_BANK_H
+#define WORD_BANK_H
+
+#include <stdint.h>
+#include "sqlite3.h"
+
+// The words table held in memory as one NUL-separated block plus an index
+// of word pointers. A bank is immutable once published and reference
+// counted, so a reload swaps in a new one atomically while rounds and AI
+// requests keep the bank they acquired. The words_version row (bumped by
+// triggers on words) identifies it; the FNV-1a hash of the block is the
+// AI candidate set id, so embeddings survive reloads that change nothing.
+//
+// Words are loaded sorted by (category, difficulty), so every such group
+// is a contiguous index range and a room's filter resolves to a few
+// ranges without touching SQL.
+
+#define WORD_MAX_LEN 31
+#define WORD_CATEGORY_MAX_LEN 15
+#define WORD_LANGUAGE_MAX_LEN 7
+#define WORD_DIFFICULTY_MAX 3 // 1 easy, 2 medium, 3 hard; 0 in filters = any
+
+typedef struct {
+    uint16_t category; // index into WordBank.category
+    uint8_t difficulty;
+    uint32_t start;    // first word index
+    uint32_t count;
+} WordGroup;
+
+typedef struct {
+    uint32_t version; // words_version.version at load time
+    uint32_t set_id;  // hash of the block
+    uint32_t count;
+    uint32_t len;
+    char* block;
+    const char** word; // word[i] points into block
+    uint32_t num_categories;
+    char (*category)[WORD_CATEGORY_MAX_LEN + 1];
+    uint32_t num_groups;
+    WordGroup* groups;
+    int refs;
+} WordBank;
+
+// Read the table into a new bank and publish it; 0 on success
+int word_bank_load(void);
+// Reload if the table changed since the current bank was read
+void word_bank_refresh(void);
+
+WordBank* word_bank_acquire(void); // NULL before the first load
+void word_bank_release(WordBank* bank);
+
+// Import "word[,category[,difficulty[,language]]]" lines (tab or comma
+// separated, '#' comments) in a single transaction; existing words get
+// the new attributes. Returns the number of rows written, or -1.
+int word_bank_import(sqlite3* conn, const char* path);
+
+// Per-room shuffle bag: every word passing the room's filter once, in
+// random order, before any repeats; the last word of a bag never opens
+// the next one. O(1) per draw, plus one O(n) refill per n draws. Not
+// thread-safe (the room's lock covers it).
+typedef struct {
+    uint32_t* order;
+    uint32_t cap;
+    uint32_t len;
+    uint32_t pos;
+    uint32_t version; // bank the order was built for, 0 to rebuild
+    uint32_t last;    // index drawn last, UINT32_MAX if none
+    uint32_t rng;
+    char category[WORD_CATEGORY_MAX_LEN + 1]; // "" = any
+    uint8_t difficulty;                       // 0 = any
+} WordBag;
+
+void word_bag_init(WordBag* bag, uint32_t seed);
+void word_bag_free(WordBag* bag);
+// Restrict the bag; a filter nothing matches falls back to every word
+void word_bag_set_filter(WordBag* bag, const char* category, int difficulty);
+// Copy the next word (at most size - 1 bytes) into out; 0 on success, -1
+// if the bank is empty
+int word_bag_next(WordBag* bag, char* out, int size);
+
+#endif